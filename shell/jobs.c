@@ -0,0 +1,217 @@
+#include "jobs.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+
+static struct job jobs[MAX_JOBS];
+
+/* Number of the job most recently started or stopped, for fg and bg. */
+static int current_job;
+
+/* Records what waitpid reported for pid. Called from the SIGCHLD handler,
+ * so it only updates the table in place. */
+static void mark_process(pid_t pid, int status) {
+    for (int i = 0; i < MAX_JOBS; i++) {
+        for (int j = 0; j < jobs[i].nprocs; j++) {
+            struct job_process *p = &jobs[i].procs[j];
+            if (p->pid != pid) {
+                continue;
+            }
+            if (WIFSTOPPED(status)) {
+                p->stopped = true;
+                p->status = status;
+                current_job = jobs[i].id;
+            } else if (WIFCONTINUED(status)) {
+                p->stopped = false;
+            } else {
+                p->completed = true;
+                p->status = status;
+            }
+            return;
+        }
+    }
+}
+
+/* Reaps every child that has changed state. */
+static void sigchld_handler(int sig) {
+    int saved_errno = errno;
+    pid_t pid;
+    int status;
+    while ((pid = waitpid(-1, &status, WNOHANG | WUNTRACED | WCONTINUED)) >
+           0) {
+        mark_process(pid, status);
+    }
+    errno = saved_errno;
+}
+
+void jobs_init(void) {
+    struct sigaction sa;
+    sa.sa_handler = sigchld_handler;
+    sigemptyset(&sa.sa_mask);
+    /* Restart fgets on the terminal instead of failing it. */
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGCHLD, &sa, NULL);
+}
+
+static void set_sigchld_mask(int how) {
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGCHLD);
+    sigprocmask(how, &set, NULL);
+}
+
+void jobs_block(void) {
+    set_sigchld_mask(SIG_BLOCK);
+}
+
+void jobs_unblock(void) {
+    set_sigchld_mask(SIG_UNBLOCK);
+}
+
+struct job *job_create(const char *command, int nprocs, bool background) {
+    for (int i = 0; i < MAX_JOBS; i++) {
+        struct job *job = &jobs[i];
+        if (job->id != 0) {
+            continue;
+        }
+        job->command = strdup(command);
+        job->procs = calloc(nprocs, sizeof(struct job_process));
+        if (job->command == NULL || job->procs == NULL) {
+            free(job->command);
+            free(job->procs);
+            job->command = NULL;
+            job->procs = NULL;
+            return NULL;
+        }
+        job->id = i + 1;
+        job->pgid = 0;
+        job->nprocs = 0;
+        job->background = background;
+        current_job = job->id;
+        return job;
+    }
+    return NULL;
+}
+
+void job_add_process(struct job *job, pid_t pid) {
+    if (job->pgid == 0) {
+        job->pgid = pid;
+    }
+    struct job_process *p = &job->procs[job->nprocs++];
+    p->pid = pid;
+    p->stopped = false;
+    p->completed = false;
+}
+
+enum job_state job_state(const struct job *job) {
+    enum job_state state = JOB_DONE;
+    for (int i = 0; i < job->nprocs; i++) {
+        if (!job->procs[i].completed) {
+            if (!job->procs[i].stopped) {
+                return JOB_RUNNING;
+            }
+            state = JOB_STOPPED;
+        }
+    }
+    return state;
+}
+
+void job_continue(struct job *job) {
+    for (int i = 0; i < job->nprocs; i++) {
+        job->procs[i].stopped = false;
+    }
+    kill(-job->pgid, SIGCONT);
+}
+
+void job_wait(struct job *job) {
+    sigset_t mask;
+    sigprocmask(SIG_BLOCK, NULL, &mask);
+    sigdelset(&mask, SIGCHLD);
+    while (job_state(job) == JOB_RUNNING) {
+        sigsuspend(&mask);
+    }
+}
+
+void job_free(struct job *job) {
+    free(job->command);
+    free(job->procs);
+    memset(job, 0, sizeof(*job));
+}
+
+struct job *job_find(const char *spec) {
+    int id = current_job;
+    if (spec != NULL) {
+        char *end;
+        id = strtol(spec[0] == '%' ? spec + 1 : spec, &end, 10);
+        if (*end != '\0') {
+            return NULL;
+        }
+    } else if (id < 1 || id > MAX_JOBS || jobs[id - 1].id == 0) {
+        /* The most recent job is gone; take the highest numbered one. */
+        for (id = MAX_JOBS; id > 0 && jobs[id - 1].id == 0; id--) {
+        }
+    }
+    if (id < 1 || id > MAX_JOBS || jobs[id - 1].id == 0) {
+        return NULL;
+    }
+    return &jobs[id - 1];
+}
+
+void jobs_foreach(void (*fun)(struct job *job)) {
+    for (int i = 0; i < MAX_JOBS; i++) {
+        if (jobs[i].id != 0) {
+            fun(&jobs[i]);
+        }
+    }
+}
+
+/* Decodes how a job that is no longer running ended. Returns the signal that
+ * stopped or killed it, or 0 and the exit code of its last process in
+ * *code. */
+static int job_ending(const struct job *job, int *code) {
+    *code = 0;
+    if (job_state(job) == JOB_STOPPED) {
+        for (int i = 0; i < job->nprocs; i++) {
+            if (job->procs[i].stopped) {
+                return WSTOPSIG(job->procs[i].status);
+            }
+        }
+    }
+    /* A pipeline's status is that of its last process. */
+    int status = job->procs[job->nprocs - 1].status;
+    if (WIFSIGNALED(status)) {
+        return WTERMSIG(status);
+    }
+    *code = WEXITSTATUS(status);
+    return 0;
+}
+
+int job_exit_status(const struct job *job) {
+    int code;
+    int sig = job_ending(job, &code);
+    return sig != 0 ? 128 + sig : code;
+}
+
+void job_print(const struct job *job) {
+    char state[32] = "Running";
+    enum job_state s = job_state(job);
+    if (s == JOB_STOPPED) {
+        strcpy(state, "Stopped");
+    } else if (s == JOB_DONE) {
+        int code;
+        int sig = job_ending(job, &code);
+        if (sig != 0) {
+            snprintf(state, sizeof(state), "%s", strsignal(sig));
+        } else if (code != 0) {
+            snprintf(state, sizeof(state), "Exit %d", code);
+        } else {
+            strcpy(state, "Done");
+        }
+    }
+    printf("[%d]%c %-12s %s\n", job->id, job->id == current_job ? '+' : ' ',
+           state, job->command);
+}
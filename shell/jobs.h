@@ -0,0 +1,77 @@
+#ifndef JOBS_H_
+#define JOBS_H_
+
+#include <stdbool.h>
+#include <sys/types.h>
+#include <termios.h>
+
+/* The job table holds every pipeline the shell has started and not yet
+ * forgotten. A SIGCHLD handler reaps the processes as they stop, continue or
+ * exit, so background jobs never make the shell wait. Code that reads or
+ * changes the table must have SIGCHLD blocked with jobs_block. */
+
+/* Most jobs the table can hold at once. */
+#define MAX_JOBS 64
+
+enum job_state { JOB_RUNNING, JOB_STOPPED, JOB_DONE };
+
+/* One process of a job, as last reported by waitpid. */
+struct job_process {
+    pid_t pid;
+    int status;
+    bool stopped;
+    bool completed;
+};
+
+struct job {
+    int id;          /* 1-based number shown to the user; 0 if unused */
+    pid_t pgid;      /* process group of the job, or 0 before it starts */
+    char *command;   /* the command line as typed, for messages */
+    bool background;
+    struct job_process *procs;
+    int nprocs;
+    struct termios tmodes; /* terminal modes when the job was stopped */
+};
+
+/* Installs the SIGCHLD handler. */
+void jobs_init(void);
+
+/* Blocks and unblocks SIGCHLD around uses of the table. */
+void jobs_block(void);
+void jobs_unblock(void);
+
+/* Creates a job for a command line of up to nprocs processes. Returns NULL
+ * if the table is full or out of memory. */
+struct job *job_create(const char *command, int nprocs, bool background);
+
+/* Records a process of job, which joins the job's process group. */
+void job_add_process(struct job *job, pid_t pid);
+
+/* Returns the state of job, from the states of its processes. */
+enum job_state job_state(const struct job *job);
+
+/* Returns the exit status of a job that is no longer running, as a shell
+ * reports it: the exit code of its last process, or 128 plus the signal that
+ * killed it, or that stopped the job. */
+int job_exit_status(const struct job *job);
+
+/* Sends SIGCONT to job and marks its processes as running again. */
+void job_continue(struct job *job);
+
+/* Waits until job is no longer running. */
+void job_wait(struct job *job);
+
+/* Removes job from the table. */
+void job_free(struct job *job);
+
+/* Returns the job named by spec, which is "N" or "%N", or the most recent
+ * job if spec is NULL. Returns NULL if there is no such job. */
+struct job *job_find(const char *spec);
+
+/* Calls fun on every job, in order of their numbers. fun may free the job. */
+void jobs_foreach(void (*fun)(struct job *job));
+
+/* Prints "[N] State  command" for job. */
+void job_print(const struct job *job);
+
+#endif
@@ -0,0 +1,199 @@
+#include "path_cache.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* A command and where it was found. path is NULL once the entry has been
+ * forgotten; the slot keeps its command so probe runs stay intact. */
+struct path_entry {
+    char *cmd;
+    char *path;
+    uint32_t hash;
+    unsigned hits;
+};
+
+/* Open-addressing table with linear probing, never more than half full. */
+static struct path_entry *entries;
+static size_t capacity;
+static size_t used;
+
+/* Bumped whenever paths handed out may have gone stale. */
+static unsigned generation = 1;
+
+/* The $PATH the table was filled from, and its directories, which point
+ * into dir_buf. */
+static char *cached_path;
+static char *dir_buf;
+static char **dirs;
+static size_t ndirs;
+
+static uint32_t hash_cmd(const char *cmd) {
+    uint32_t h = 2166136261u;
+    for (; *cmd != '\0'; cmd++) {
+        h = (h ^ (unsigned char) *cmd) * 16777619u;
+    }
+    return h;
+}
+
+/* Returns the slot holding cmd, or the empty slot where it belongs. */
+static struct path_entry *probe(const char *cmd, uint32_t hash) {
+    size_t i = hash & (capacity - 1);
+    while (entries[i].cmd != NULL) {
+        if (entries[i].hash == hash && strcmp(entries[i].cmd, cmd) == 0) {
+            break;
+        }
+        i = (i + 1) & (capacity - 1);
+    }
+    return &entries[i];
+}
+
+static int grow(void) {
+    size_t old_capacity = capacity;
+    struct path_entry *old = entries;
+    capacity = capacity ? capacity * 2 : 64;
+    entries = calloc(capacity, sizeof(struct path_entry));
+    if (entries == NULL) {
+        entries = old;
+        capacity = old_capacity;
+        return -1;
+    }
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old[i].cmd != NULL) {
+            *probe(old[i].cmd, old[i].hash) = old[i];
+        }
+    }
+    free(old);
+    return 0;
+}
+
+/* Splits $PATH into dirs, keeping a copy to notice when it changes. Empty
+ * components are skipped. */
+static void split_path(const char *path) {
+    free(cached_path);
+    free(dir_buf);
+    free(dirs);
+    ndirs = 0;
+    cached_path = strdup(path);
+    dir_buf = strdup(path);
+    dirs = calloc(strlen(path) / 2 + 1, sizeof(char *));
+    if (cached_path == NULL || dir_buf == NULL || dirs == NULL) {
+        /* Search nothing, and try again on the next lookup. */
+        free(cached_path);
+        cached_path = NULL;
+        return;
+    }
+    for (char *dir = strtok(dir_buf, ":"); dir != NULL;
+         dir = strtok(NULL, ":")) {
+        dirs[ndirs++] = dir;
+    }
+}
+
+/* Drops the table if $PATH is not the value it was filled from. */
+static void check_path(void) {
+    const char *path = getenv("PATH");
+    if (path == NULL) {
+        path = "";
+    }
+    if (cached_path == NULL || strcmp(cached_path, path) != 0) {
+        path_cache_clear();
+        split_path(path);
+    }
+}
+
+/* Searches the directories of $PATH for an executable named cmd. */
+static char *search(const char *cmd) {
+    size_t cmd_len = strlen(cmd);
+    for (size_t i = 0; i < ndirs; i++) {
+        size_t dir_len = strlen(dirs[i]);
+        char *candidate = malloc(dir_len + cmd_len + 2);
+        if (candidate == NULL) {
+            return NULL;
+        }
+        memcpy(candidate, dirs[i], dir_len);
+        candidate[dir_len] = '/';
+        memcpy(candidate + dir_len + 1, cmd, cmd_len + 1);
+        if (access(candidate, X_OK) == 0) {
+            return candidate;
+        }
+        free(candidate);
+    }
+    return NULL;
+}
+
+const char *path_cache_lookup(const char *cmd) {
+    if (strchr(cmd, '/') != NULL) {
+        return cmd;
+    }
+    check_path();
+    if (2 * (used + 1) > capacity && grow() != 0) {
+        return NULL;
+    }
+
+    uint32_t hash = hash_cmd(cmd);
+    struct path_entry *entry = probe(cmd, hash);
+    if (entry->path != NULL) {
+        entry->hits++;
+        return entry->path;
+    }
+
+    char *path = search(cmd);
+    if (path == NULL) {
+        return NULL;
+    }
+    if (entry->cmd == NULL) {
+        if ((entry->cmd = strdup(cmd)) == NULL) {
+            free(path);
+            return NULL;
+        }
+        entry->hash = hash;
+        used++;
+    }
+    entry->path = path;
+    entry->hits = 1;
+    return path;
+}
+
+void path_cache_forget(const char *cmd) {
+    if (capacity == 0) {
+        return;
+    }
+    struct path_entry *entry = probe(cmd, hash_cmd(cmd));
+    free(entry->path);
+    entry->path = NULL;
+    generation++;
+}
+
+void path_cache_clear(void) {
+    for (size_t i = 0; i < capacity; i++) {
+        free(entries[i].cmd);
+        free(entries[i].path);
+    }
+    free(entries);
+    entries = NULL;
+    capacity = 0;
+    used = 0;
+    generation++;
+}
+
+unsigned path_cache_generation(void) {
+    return generation;
+}
+
+void path_cache_print(FILE *out) {
+    bool empty = true;
+    for (size_t i = 0; i < capacity; i++) {
+        if (entries[i].path != NULL) {
+            if (empty) {
+                fprintf(out, "hits\tcommand\n");
+                empty = false;
+            }
+            fprintf(out, "%4u\t%s\n", entries[i].hits, entries[i].path);
+        }
+    }
+    if (empty) {
+        fprintf(out, "hash: hash table empty\n");
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef PATH_CACHE_H_
+#define PATH_CACHE_H_
+
+#include <stdio.h>
+
+/* Remembers where in $PATH each command was found, so that running a command
+ * again costs one table probe instead of an access() call per directory. The
+ * whole table is dropped whenever $PATH changes, which lookups notice; the
+ * shell never changes $PATH itself. */
+
+/* Returns the path of the executable cmd names, searching $PATH only on the
+ * first lookup. Commands containing a slash are returned as they are. Returns
+ * NULL if cmd is not found. The string belongs to the cache and is valid
+ * until the entry is forgotten or $PATH changes. */
+const char *path_cache_lookup(const char *cmd);
+
+/* Drops the entry for cmd, e.g. after executing its cached path failed. */
+void path_cache_forget(const char *cmd);
+
+/* Drops every entry. */
+void path_cache_clear(void);
+
+/* Returns a number that changes whenever entries are forgotten or dropped.
+ * A path kept from an earlier lookup is still valid while the number is the
+ * same as when it was looked up, so callers can skip the lookup. */
+unsigned path_cache_generation(void);
+
+/* Prints the cached commands with their paths and how often they were hit. */
+void path_cache_print(FILE *out);
+
+#endif
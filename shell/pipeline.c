@@ -0,0 +1,57 @@
+#include "pipeline.h"
+
+#include <stdio.h>
+#include <string.h>
+
+int parse_pipeline(char **tokens, size_t length, char **words,
+                   struct process *procs, bool *background) {
+    size_t w = 0;
+    int nprocs = 0;
+    struct process *p = NULL;
+
+    *background = length > 0 &&
+                   strcmp(tokens[length - 1], "&") == 0;
+    if (*background) {
+        length--;
+    }
+
+    for (size_t i = 0; i <= length; i++) {
+        char *token = i < length ? tokens[i] : NULL;
+        if (p == NULL) {
+            if (token == NULL && nprocs == 0) {
+                return 0;
+            }
+            p = &procs[nprocs++];
+            memset(p, 0, sizeof(*p));
+            p->argv = &words[w];
+            p->fundex = -1;
+        }
+
+        if (token == NULL || strcmp(token, "|") == 0) {
+            if (p->argv == &words[w]) {
+                fprintf(stderr, "syntax error near %s\n",
+                        token ? "'|'" : *background ? "'&'" : "end of line");
+                return -1;
+            }
+            words[w++] = NULL;
+            p = NULL;
+        } else if (strcmp(token, "&") == 0) {
+            fprintf(stderr, "syntax error near '&'\n");
+            return -1;
+        } else if (strcmp(token, "<") == 0 || strcmp(token, ">") == 0) {
+            char *file = ++i < length ? tokens[i] : NULL;
+            if (file == NULL || strcmp(file, "|") == 0) {
+                fprintf(stderr, "syntax error near '%s'\n", token);
+                return -1;
+            }
+            if (token[0] == '<') {
+                p->infile = file;
+            } else {
+                p->outfile = file;
+            }
+        } else {
+            words[w++] = token;
+        }
+    }
+    return nprocs;
+}
@@ -0,0 +1,26 @@
+#ifndef PIPELINE_H_
+#define PIPELINE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* One command of a pipeline, with its arguments and redirections. */
+struct process {
+    char **argv;         /* NULL-terminated, pointing into the line's tokens */
+    char *infile;        /* from "< file", or NULL */
+    char *outfile;       /* from "> file", or NULL */
+    int fundex;          /* built-in command to run, or -1 */
+    const char *program; /* resolved executable otherwise, or NULL */
+    unsigned generation; /* path_cache_generation() when program was found */
+};
+
+/* Splits the length tokens of a line at each "|" into the processes of a
+ * pipeline, and sets *background if the line ends with "&". The argument
+ * vectors are built in words, which needs room for every token plus one, and
+ * procs needs room for one more process than there are "|" tokens. The
+ * processes are left unresolved. Returns the number of processes, 0 for a
+ * blank line, or -1 after reporting a syntax error. */
+int parse_pipeline(char **tokens, size_t length, char **words,
+                   struct process *procs, bool *background);
+
+#endif
@@ -0,0 +1,444 @@
+#include "script.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tokenizer.h"
+
+/* Size of the blocks a script is carved from. A larger allocation gets a
+ * block of its own. */
+#define SCRIPT_BLOCK_SIZE 16384
+
+struct script_block {
+    struct script_block *next;
+    size_t used;
+    size_t size;
+    void *data[]; /* aligned for the pointers the nodes hold */
+};
+
+struct parser {
+    const char *name; /* of the script, for errors */
+    const char *pos;  /* start of the next line */
+    int line_num;
+    int depth;        /* loops around the current line */
+    bool ok;
+    struct script *script;
+    char **tokens;    /* words of the current line, kept in script */
+    size_t ntokens;
+    size_t tokens_cap;
+    bool comment;     /* the current line starts with "#" */
+};
+
+static void syntax_error(struct parser *ps, int line_num, const char *msg) {
+    fprintf(stderr, "%s: line %d: %s\n", ps->name, line_num, msg);
+    ps->ok = false;
+}
+
+/* Returns size zeroed bytes from the blocks of the script, or NULL if out of
+ * memory. */
+static void *script_alloc(struct parser *ps, size_t size) {
+    size = (size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+    struct script_block *block = ps->script->blocks;
+    if (block == NULL || block->size - block->used < size) {
+        size_t block_size = size > SCRIPT_BLOCK_SIZE ? size : SCRIPT_BLOCK_SIZE;
+        struct script_block *fresh = malloc(sizeof(*fresh) + block_size);
+        if (fresh == NULL) {
+            perror("malloc");
+            ps->ok = false;
+            return NULL;
+        }
+        fresh->used = 0;
+        fresh->size = block_size;
+        /* A block of its own is full at once; keep filling the current one. */
+        if (block != NULL && block_size > SCRIPT_BLOCK_SIZE) {
+            fresh->next = block->next;
+            block->next = fresh;
+        } else {
+            fresh->next = block;
+            ps->script->blocks = fresh;
+        }
+        block = fresh;
+    }
+    void *p = (char *) block->data + block->used;
+    block->used += size;
+    memset(p, 0, size);
+    return p;
+}
+
+/* Copies a word of the current line into the script, unless the line is a
+ * comment. */
+static void add_token(char *word, size_t n, void *aux) {
+    struct parser *ps = aux;
+    if (ps->ntokens == 0 && word[0] == '#') {
+        ps->comment = true;
+    }
+    if (ps->comment || !ps->ok) {
+        return;
+    }
+    if (ps->ntokens == ps->tokens_cap) {
+        size_t cap = ps->tokens_cap ? 2 * ps->tokens_cap : 16;
+        char **grown = realloc(ps->tokens, cap * sizeof(char *));
+        if (grown == NULL) {
+            perror("realloc");
+            ps->ok = false;
+            return;
+        }
+        ps->tokens = grown;
+        ps->tokens_cap = cap;
+    }
+    char *copy = script_alloc(ps, n + 1);
+    if (copy != NULL) {
+        memcpy(copy, word, n + 1);
+        ps->tokens[ps->ntokens++] = copy;
+    }
+}
+
+/* Returns the next line, whose length without its newline is stored in
+ * *len, or NULL at the end of the text. */
+static const char *next_line(struct parser *ps, size_t *len) {
+    if (*ps->pos == '\0') {
+        return NULL;
+    }
+    const char *line = ps->pos;
+    *len = strcspn(line, "\n");
+    ps->pos += *len + (line[*len] == '\n');
+    ps->line_num++;
+    return line;
+}
+
+/* Tokenizes the next line that is neither blank nor a comment into
+ * ps->tokens, and returns the line, of *len bytes. Returns NULL at the end of
+ * the text or if out of memory. */
+static const char *next_tokens(struct parser *ps, size_t *len) {
+    const char *line;
+    while (ps->ok && (line = next_line(ps, len)) != NULL) {
+        ps->ntokens = 0;
+        ps->comment = false;
+        tokenize_each(line, *len, add_token, ps);
+        if (ps->ok && ps->ntokens > 0) {
+            return line;
+        }
+    }
+    return NULL;
+}
+
+static bool is_name(const char *word, size_t len) {
+    if (len == 0 || isdigit((unsigned char) word[0])) {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        if (!isalnum((unsigned char) word[i]) && word[i] != '_') {
+            return false;
+        }
+    }
+    return true;
+}
+
+static struct script_node *parse_block(struct parser *ps, int for_line);
+
+/* Parses "for NAME in WORD... [; do]" and the body of the loop. */
+static void parse_for(struct parser *ps, struct script_node *node) {
+    char **tokens = ps->tokens;
+    size_t length = ps->ntokens;
+    node->type = SCRIPT_FOR;
+
+    /* The words end at "; do", "WORD; do", or the end of the line. */
+    bool has_do = strcmp(tokens[length - 1], "do") == 0;
+    if (has_do) {
+        length--;
+    }
+    char *last = length > 0 ? tokens[length - 1] : NULL;
+    if (last != NULL && strcmp(last, ";") == 0) {
+        length--;
+    } else if (last != NULL && last[strlen(last) - 1] == ';') {
+        last[strlen(last) - 1] = '\0';
+    } else if (has_do) {
+        syntax_error(ps, node->line_num, "expected ';' before 'do'");
+        return;
+    }
+
+    if (length < 3 || strcmp(tokens[2], "in") != 0 ||
+        !is_name(tokens[1], strlen(tokens[1]))) {
+        syntax_error(ps, node->line_num, "expected 'for NAME in WORD...'");
+        return;
+    }
+    node->var = tokens[1];
+    node->nvalues = length - 3;
+    node->values = script_alloc(ps, (node->nvalues + 1) * sizeof(char *));
+    if (node->values == NULL) {
+        return;
+    }
+    for (int i = 0; i < node->nvalues; i++) {
+        node->values[i] = tokens[i + 3];
+        node->expand |= strchr(node->values[i], '$') != NULL;
+    }
+
+    if (!has_do) {
+        size_t len;
+        bool is_do = next_tokens(ps, &len) != NULL && ps->ntokens == 1 &&
+                     strcmp(ps->tokens[0], "do") == 0;
+        if (!ps->ok) {
+            return;
+        }
+        if (!is_do) {
+            syntax_error(ps, ps->line_num, "expected 'do'");
+            return;
+        }
+    }
+
+    if (ps->depth == MAX_LOOP_DEPTH) {
+        syntax_error(ps, node->line_num, "loops nested too deeply");
+        return;
+    }
+    ps->depth++;
+    node->body = parse_block(ps, node->line_num);
+    ps->depth--;
+}
+
+/* Splits a command line of len bytes into its pipeline. */
+static void parse_command(struct parser *ps, struct script_node *node,
+                          const char *line, size_t len) {
+    size_t length = ps->ntokens;
+    int max_procs = 1;
+    for (size_t i = 0; i < length; i++) {
+        max_procs += strcmp(ps->tokens[i], "|") == 0;
+    }
+    node->type = SCRIPT_COMMAND;
+    node->text = script_alloc(ps, len + 1);
+    node->nwords = length + 1;
+    node->words = script_alloc(ps, (length + 1) * sizeof(char *));
+    node->procs = script_alloc(ps, max_procs * sizeof(struct process));
+    if (node->text == NULL || node->words == NULL || node->procs == NULL) {
+        return;
+    }
+    memcpy(node->text, line, len);
+
+    node->nprocs = parse_pipeline(ps->tokens, length, node->words, node->procs,
+                                  &node->background);
+    if (node->nprocs <= 0) {
+        syntax_error(ps, node->line_num, "invalid command");
+        return;
+    }
+
+    for (int i = 0; i < node->nprocs; i++) {
+        struct process *p = &node->procs[i];
+        node->expand |= (p->infile != NULL && strchr(p->infile, '$')) ||
+                        (p->outfile != NULL && strchr(p->outfile, '$'));
+    }
+    for (size_t i = 0; i < node->nwords; i++) {
+        node->expand |= node->words[i] != NULL && strchr(node->words[i], '$');
+    }
+}
+
+/* Parses lines up to the "done" that closes the loop started on line
+ * for_line, or up to the end of the text if for_line is 0. */
+static struct script_node *parse_block(struct parser *ps, int for_line) {
+    struct script_node *first = NULL;
+    struct script_node **tail = &first;
+    const char *line;
+    size_t len;
+
+    while (ps->ok && (line = next_tokens(ps, &len)) != NULL) {
+        char *word = ps->tokens[0];
+        if (strcmp(word, "done") == 0) {
+            if (ps->ntokens != 1) {
+                syntax_error(ps, ps->line_num, "expected newline after 'done'");
+            } else if (for_line == 0) {
+                syntax_error(ps, ps->line_num, "'done' without 'for'");
+            }
+            return first;
+        }
+
+        struct script_node *node = script_alloc(ps, sizeof(struct script_node));
+        if (node == NULL) {
+            break;
+        }
+        node->line_num = ps->line_num;
+        *tail = node;
+        tail = &node->next;
+
+        if (strcmp(word, "for") == 0) {
+            parse_for(ps, node);
+        } else if (strcmp(word, "do") == 0) {
+            syntax_error(ps, ps->line_num, "'do' without 'for'");
+        } else {
+            parse_command(ps, node, line, len);
+        }
+    }
+
+    if (ps->ok && for_line != 0) {
+        syntax_error(ps, for_line, "'for' without 'done'");
+    }
+    return first;
+}
+
+struct script *script_parse(const char *text, const char *name, bool *ok) {
+    struct script *script = calloc(1, sizeof(struct script));
+    if (script == NULL) {
+        perror("calloc");
+        *ok = false;
+        return NULL;
+    }
+    struct parser ps = {.name = name, .pos = text, .ok = true,
+                        .script = script};
+    script->first = parse_block(&ps, 0);
+    free(ps.tokens);
+    *ok = ps.ok;
+    return script;
+}
+
+/* Returns the value bound to the loop variable name[0, len), or NULL. */
+static const char *var_value(const struct script_vars *vars, const char *name,
+                             size_t len) {
+    for (int i = vars->n - 1; i >= 0; i--) {
+        if (strncmp(vars->names[i], name, len) == 0 &&
+            vars->names[i][len] == '\0') {
+            return vars->values[i];
+        }
+    }
+    return NULL;
+}
+
+/* Writes word with its loop variables expanded to out, unless out is NULL,
+ * and returns the length of the result. "$" followed by anything but the name
+ * of a loop variable is kept as it is. */
+static size_t expand_word(const char *word, const struct script_vars *vars,
+                          char *out) {
+    size_t n = 0;
+    const char *p = word;
+    while (*p != '\0') {
+        const char *value = NULL;
+        size_t skip = 0;
+        if (p[0] == '$') {
+            bool braces = p[1] == '{';
+            const char *name = p + 1 + braces;
+            size_t len = 0;
+            while (name[len] != '\0' && is_name(name, len + 1)) {
+                len++;
+            }
+            if (len > 0 && (!braces || name[len] == '}')) {
+                value = var_value(vars, name, len);
+                skip = 1 + len + 2 * braces;
+            }
+        }
+
+        if (value != NULL) {
+            size_t value_len = strlen(value);
+            if (out != NULL) {
+                memcpy(out + n, value, value_len);
+            }
+            n += value_len;
+            p += skip;
+        } else {
+            if (out != NULL) {
+                out[n] = *p;
+            }
+            n++;
+            p++;
+        }
+    }
+    if (out != NULL) {
+        out[n] = '\0';
+    }
+    return n;
+}
+
+/* Bytes needed to expand word, which is 0 if it is used as it is. */
+static size_t expanded_size(const char *word, const struct script_vars *vars) {
+    if (word == NULL || strchr(word, '$') == NULL) {
+        return 0;
+    }
+    return expand_word(word, vars, NULL) + 1;
+}
+
+/* Returns word, or its expansion written at *out if it has a "$". */
+static char *maybe_expand(char *word, const struct script_vars *vars,
+                          char **out) {
+    if (word == NULL || strchr(word, '$') == NULL) {
+        return word;
+    }
+    char *expanded = *out;
+    *out += expand_word(word, vars, expanded) + 1;
+    return expanded;
+}
+
+/* Grows *buf to at least need bytes. Returns 0 on success, -1 if out of
+ * memory. */
+static int reserve(char **buf, size_t *cap, size_t need) {
+    if (need > *cap) {
+        char *grown = realloc(*buf, need);
+        if (grown == NULL) {
+            perror("realloc");
+            return -1;
+        }
+        *buf = grown;
+        *cap = need;
+    }
+    return 0;
+}
+
+int script_expand(const struct script_node *node,
+                  const struct script_vars *vars, char **words,
+                  struct process *procs, char **buf, size_t *cap) {
+    /* Size everything first, so the buffer never moves while filled. */
+    size_t need = 0;
+    for (size_t i = 0; i < node->nwords; i++) {
+        need += expanded_size(node->words[i], vars);
+    }
+    for (int i = 0; i < node->nprocs; i++) {
+        need += expanded_size(node->procs[i].infile, vars);
+        need += expanded_size(node->procs[i].outfile, vars);
+    }
+    if (reserve(buf, cap, need) != 0) {
+        return -1;
+    }
+
+    char *out = *buf;
+    for (size_t i = 0; i < node->nwords; i++) {
+        words[i] = maybe_expand(node->words[i], vars, &out);
+    }
+    for (int i = 0; i < node->nprocs; i++) {
+        procs[i] = node->procs[i];
+        procs[i].argv = words + (node->procs[i].argv - node->words);
+        if (procs[i].argv[0] != node->procs[i].argv[0]) {
+            procs[i].fundex = -1;
+            procs[i].program = NULL;
+        }
+        procs[i].infile = maybe_expand(node->procs[i].infile, vars, &out);
+        procs[i].outfile = maybe_expand(node->procs[i].outfile, vars, &out);
+    }
+    return 0;
+}
+
+int script_expand_values(const struct script_node *node,
+                         const struct script_vars *vars, const char **values,
+                         char **buf, size_t *cap) {
+    size_t need = 0;
+    for (int i = 0; i < node->nvalues; i++) {
+        need += expanded_size(node->values[i], vars);
+    }
+    if (reserve(buf, cap, need) != 0) {
+        return -1;
+    }
+
+    char *out = *buf;
+    for (int i = 0; i < node->nvalues; i++) {
+        values[i] = maybe_expand(node->values[i], vars, &out);
+    }
+    return 0;
+}
+
+void script_destroy(struct script *script) {
+    if (script == NULL) {
+        return;
+    }
+    struct script_block *block = script->blocks;
+    while (block != NULL) {
+        struct script_block *next = block->next;
+        free(block);
+        block = next;
+    }
+    free(script);
+}
@@ -0,0 +1,92 @@
+#ifndef SCRIPT_H_
+#define SCRIPT_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "pipeline.h"
+
+/* A script is parsed once, when it is loaded, into a list of commands and
+ * loops. Each command is tokenized and split into its pipeline right away, so
+ * running it again, e.g. in a loop, needs no parsing. The nodes, and every
+ * word and array they point to, are packed into a few large blocks. Besides
+ * one command per line, scripts may hold comments starting with "#" and
+ * loops:
+ *
+ *     for NAME in WORD...; do
+ *         COMMANDS, where $NAME or ${NAME} stands for each WORD in turn
+ *     done
+ *
+ * "do" may also be on a line of its own. The WORDs may name the variables of
+ * enclosing loops; they are expanded once, when the loop starts. */
+
+/* Deepest nesting of loops. */
+#define MAX_LOOP_DEPTH 16
+
+enum script_node_type { SCRIPT_COMMAND, SCRIPT_FOR };
+
+struct script_node {
+    enum script_node_type type;
+    struct script_node *next;
+    int line_num;
+
+    /* SCRIPT_COMMAND: a pipeline, split into its processes. */
+    char *text;              /* the line, for job messages */
+    char **words;            /* the argument vectors of procs */
+    size_t nwords;
+    struct process *procs;
+    int nprocs;
+    bool background;
+    bool expand;             /* some word, or value, may name a loop
+                                variable */
+
+    /* SCRIPT_FOR: runs body once for each of values, bound to var. */
+    char *var;
+    char **values;
+    int nvalues;
+    struct script_node *body;
+};
+
+struct script_block;
+
+/* A parsed script: its first node, NULL if it is empty, and the blocks that
+ * hold it. */
+struct script {
+    struct script_node *first;
+    struct script_block *blocks;
+};
+
+/* The loop variables bound while a script runs, innermost last. */
+struct script_vars {
+    const char *names[MAX_LOOP_DEPTH];
+    const char *values[MAX_LOOP_DEPTH];
+    int n;
+};
+
+/* Parses the whole of text. Errors are reported with name and the line.
+ * Returns the script, which may be NULL if out of memory, and sets *ok to
+ * whether parsing succeeded. */
+struct script *script_parse(const char *text, const char *name, bool *ok);
+
+/* Copies the processes of the command node into procs and their arguments
+ * into words, with the loop variables in vars expanded. words needs
+ * node->nwords entries and procs node->nprocs. A process whose command name
+ * is expanded is left unresolved. The expanded words are kept in *buf, which
+ * is grown to *cap bytes as needed and can be reused for the next command.
+ * Returns 0 on success, -1 if out of memory. */
+int script_expand(const struct script_node *node,
+                  const struct script_vars *vars, char **words,
+                  struct process *procs, char **buf, size_t *cap);
+
+/* Copies the values of the loop node into values, which needs node->nvalues
+ * entries, with the loop variables in vars expanded. The expanded words are
+ * kept in *buf, grown to *cap bytes as needed, which must not be reused until
+ * the loop ends. Returns 0 on success, -1 if out of memory. */
+int script_expand_values(const struct script_node *node,
+                         const struct script_vars *vars, const char **values,
+                         char **buf, size_t *cap);
+
+/* Frees a parsed script. */
+void script_destroy(struct script *script);
+
+#endif
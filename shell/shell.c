@@ -1,7 +1,11 @@
+/* For pipe2, environ and posix_spawn_file_actions_addtcsetpgrp_np. */
+#define _GNU_SOURCE
+
 #include <ctype.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <signal.h>
+#include <spawn.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -11,6 +15,10 @@
 #include <termios.h>
 #include <unistd.h>
 
+#include "jobs.h"
+#include "path_cache.h"
+#include "pipeline.h"
+#include "script.h"
 #include "tokenizer.h"
 
 /* Convenience macro to silence compiler warnings about unused function
@@ -20,6 +28,10 @@
 /* Whether the shell is connected to an actual terminal or not. */
 bool shell_is_interactive;
 
+/* Whether jobs get process groups of their own, which the shell can stop and
+ * continue. Scripts run without, so ^C reaches their commands too. */
+bool shell_job_control = true;
+
 /* File descriptor for the shell input */
 int shell_terminal;
 
@@ -29,13 +41,22 @@ struct termios shell_tmodes;
 /* Process group id for the shell */
 pid_t shell_pgid;
 
-int cmd_exit(struct tokens *tokens);
-int cmd_help(struct tokens *tokens);
-int cmd_pwd(struct tokens *tokens);
-int cmd_cd(struct tokens *tokens);
+/* Exit status of the last command, which scripts and exit return */
+int shell_status;
+
+int cmd_exit(char *argv[]);
+int cmd_help(char *argv[]);
+int cmd_pwd(char *argv[]);
+int cmd_cd(char *argv[]);
+int cmd_hash(char *argv[]);
+int cmd_jobs(char *argv[]);
+int cmd_fg(char *argv[]);
+int cmd_bg(char *argv[]);
+int cmd_wait(char *argv[]);
 
-/* Built-in command functions take token array (see parse.h) and return int */
-typedef int cmd_fun_t(struct tokens *tokens);
+/* Built-in command functions take the NULL-terminated words of their command,
+ * without redirections, and return int */
+typedef int cmd_fun_t(char *argv[]);
 
 /* Built-in command struct and lookup table */
 typedef struct fun_desc {
@@ -48,23 +69,28 @@ fun_desc_t cmd_table[] = {
     {cmd_help, "?", "show this help menu"},
     {cmd_exit, "exit", "exit the command shell"},
     {cmd_pwd, "pwd", "prints the current working directory"}, 
-    {cmd_cd, "cd", "changes the current working directory to new directory"}
+    {cmd_cd, "cd", "changes the current working directory to new directory"},
+    {cmd_hash, "hash", "lists remembered command paths (-r forgets them)"},
+    {cmd_jobs, "jobs", "lists the jobs started from this shell"},
+    {cmd_fg, "fg", "continues a job (default: the latest) in the foreground"},
+    {cmd_bg, "bg", "continues a stopped job in the background"},
+    {cmd_wait, "wait", "waits for the given or all background jobs to end"}
 };
 
 /* Prints a helpful description for the given command */
-int cmd_help(unused struct tokens *tokens) {
+int cmd_help(unused char *argv[]) {
     for (unsigned int i = 0; i < sizeof(cmd_table) / sizeof(fun_desc_t); i++) {
         printf("%s - %s\n", cmd_table[i].cmd, cmd_table[i].doc);
     }
-    return 1;
+    return 0;
 }
 
-/* Exits this shell */
-int cmd_exit(unused struct tokens *tokens) {
-    exit(0);
+/* Exits this shell with the given status, or that of the last command */
+int cmd_exit(char *argv[]) {
+    exit(argv[1] != NULL ? atoi(argv[1]) : shell_status);
 }
 
-int cmd_pwd(unused struct tokens *tokens){
+int cmd_pwd(unused char *argv[]){
     //int size = cmd_fun_t(&tokens);
     char cwd[1024]; //change 1024 later
    if (getcwd(cwd, sizeof(cwd)) != NULL) {
@@ -76,17 +102,132 @@ int cmd_pwd(unused struct tokens *tokens){
    return 0;
 }
 
-int cmd_cd(unused struct tokens *tokens){
-    char *path = tokens_get_token(tokens, 1); //getting path
+int cmd_cd(char *argv[]){
+    char *path = argv[1]; //getting path
     if (path == NULL) {
         fprintf(stderr, "cd: missing argument\n");
         return 1;
     }
 
-    chdir(path);
+    if (chdir(path) == -1) {
+        perror(path);
+        return 1;
+    }
+    return 0;
+}
+
+/* Lists the remembered command paths, forgets them all with -r, or looks up
+ * and remembers each command given. */
+int cmd_hash(char *argv[]) {
+    if (argv[1] == NULL) {
+        path_cache_print(stdout);
+        return 0;
+    }
+
+    int status = 0;
+    for (int i = 1; argv[i] != NULL; i++) {
+        char *arg = argv[i];
+        if (strcmp(arg, "-r") == 0) {
+            path_cache_clear();
+        } else if (path_cache_lookup(arg) == NULL) {
+            fprintf(stderr, "hash: %s: not found\n", arg);
+            status = 1;
+        }
+    }
+    return status;
+}
+
+int wait_foreground(struct job *job, bool cont);
+
+/* Prints job, and forgets it if it has ended. */
+void report_job(struct job *job) {
+    job_print(job);
+    if (job_state(job) == JOB_DONE) {
+        job_free(job);
+    }
+}
+
+/* Lists every job with its state */
+int cmd_jobs(unused char *argv[]) {
+    jobs_block();
+    jobs_foreach(report_job);
+    jobs_unblock();
     return 0;
 }
 
+/* Finds the job named by argv[1], or the latest one, that has not ended.
+ * SIGCHLD must be blocked. */
+struct job *find_live_job(char *argv[]) {
+    struct job *job = job_find(argv[1]);
+    if (job == NULL || job_state(job) == JOB_DONE) {
+        fprintf(stderr, "%s: %s: no such job\n", argv[0],
+                argv[1] != NULL ? argv[1] : "current");
+        return NULL;
+    }
+    return job;
+}
+
+/* Continues a job in the foreground and waits for it */
+int cmd_fg(char *argv[]) {
+    int status = 1;
+    jobs_block();
+    struct job *job = find_live_job(argv);
+    if (job != NULL) {
+        printf("%s\n", job->command);
+        status = wait_foreground(job, true);
+    }
+    jobs_unblock();
+    return status;
+}
+
+/* Continues a stopped job in the background */
+int cmd_bg(char *argv[]) {
+    jobs_block();
+    struct job *job = find_live_job(argv);
+    if (job != NULL) {
+        job->background = true;
+        job_continue(job);
+        printf("[%d] %s\n", job->id, job->command);
+    }
+    jobs_unblock();
+    return job != NULL ? 0 : 1;
+}
+
+/* Waits for a background job to stop or end, and forgets it if it ended. */
+void wait_background(struct job *job) {
+    if (job->background) {
+        job_wait(job);
+        if (job_state(job) == JOB_DONE) {
+            job_free(job);
+        }
+    }
+}
+
+/* Waits for the given jobs, or every background job. Returns the status of
+ * the last job given. */
+int cmd_wait(char *argv[]) {
+    int status = 0;
+    jobs_block();
+    if (argv[1] == NULL) {
+        jobs_foreach(wait_background);
+    }
+    for (int i = 1; argv[i] != NULL; i++) {
+        struct job *job = job_find(argv[i]);
+        if (job == NULL) {
+            fprintf(stderr, "wait: %s: no such job\n", argv[i]);
+            status = 1;
+            continue;
+        }
+        job_wait(job);
+        status = job_exit_status(job);
+        if (job_state(job) == JOB_DONE) {
+            job_free(job);
+        }
+    }
+    jobs_unblock();
+    return status;
+}
+
 /* Looks up the built-in command, if it exists. */
 int lookup(char *cmd) {
     if (cmd != NULL) {
@@ -99,6 +240,21 @@ int lookup(char *cmd) {
     return -1;
 }
 
+/* Finds which built-in function or program p runs, unless it was found before
+ * and still holds. Returns false if there is neither. */
+bool resolve_process(struct process *p) {
+    if (p->fundex >= 0 ||
+        (p->program != NULL && p->generation == path_cache_generation())) {
+        return true;
+    }
+    if ((p->fundex = lookup(p->argv[0])) >= 0) {
+        return true;
+    }
+    p->program = path_cache_lookup(p->argv[0]);
+    p->generation = path_cache_generation();
+    return p->program != NULL;
+}
+
 /* Intialization procedures for this shell */
 void init_shell() {
     /* Our shell is connected to standard input. */
@@ -128,12 +284,426 @@ void init_shell() {
     }
 }
 
-int main(unused int argc, unused char *argv[]) {
+/* Forks a child that runs the built-in of p, for a built-in inside a
+ * pipeline or in the background, as a process of job, with in_fd and out_fd
+ * as its standard input and output. The first process of a job starts its
+ * process group. Returns the child's pid, or -1. */
+pid_t fork_builtin(struct process *p, struct job *job, int in_fd, int out_fd) {
+    pid_t pgid = job->pgid;
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("fork");
+        return -1;
+    }
+
+    if (pid == 0) { // child process
+        /* Join the job's group, and take the terminal if this is the first
+         * process, while SIGTTOU is still ignored. */
+        if (shell_job_control) {
+            setpgid(0, pgid);
+        }
+        if (pgid == 0 && !job->background && shell_is_interactive) {
+            tcsetpgrp(shell_terminal, getpid());
+        }
+        jobs_unblock();
+
+        struct sigaction sa_default;
+        sa_default.sa_handler = SIG_DFL;
+        sigemptyset(&sa_default.sa_mask);
+        sa_default.sa_flags = 0;
+        sigaction(SIGINT, &sa_default, NULL);
+        sigaction(SIGTSTP, &sa_default, NULL);
+        sigaction(SIGTTOU, &sa_default, NULL);
+
+        if (in_fd != STDIN_FILENO) {
+            dup2(in_fd, STDIN_FILENO);
+        }
+        if (out_fd != STDOUT_FILENO) {
+            dup2(out_fd, STDOUT_FILENO);
+        }
+
+        int status = cmd_table[p->fundex].fun(p->argv);
+        fflush(stdout);
+        _exit(status); // leave the shell's other stdio buffers alone
+    }
+
+    // parent process; set the group here too, whichever side runs first
+    if (shell_job_control) {
+        setpgid(pid, pgid != 0 ? pgid : pid);
+    }
+    return pid;
+}
+
+/* Like fork_builtin, but starts the program of p with posix_spawn. The child
+ * shares the shell's memory until it execs instead of copying its page
+ * tables, so launching costs the same however large the shell grows. Sets
+ * errno when it returns -1. */
+pid_t spawn_process(struct process *p, struct job *job, int in_fd, int out_fd) {
+    pid_t pgid = job->pgid;
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawnattr_init(&attr);
+
+    /* The pipe and file descriptors are close-on-exec; only these copies
+     * survive. */
+    if (in_fd != STDIN_FILENO) {
+        posix_spawn_file_actions_adddup2(&actions, in_fd, STDIN_FILENO);
+    }
+    if (out_fd != STDOUT_FILENO) {
+        posix_spawn_file_actions_adddup2(&actions, out_fd, STDOUT_FILENO);
+    }
+#ifdef __GLIBC_PREREQ
+#if __GLIBC_PREREQ(2, 35)
+    /* Take the terminal before the exec, so the first process never runs in
+     * the background. Otherwise the shell hands it over after the launch. */
+    if (pgid == 0 && !job->background && shell_is_interactive) {
+        posix_spawn_file_actions_addtcsetpgrp_np(&actions, shell_terminal);
+    }
+#endif
+#endif
+
+    sigset_t defaults;
+    sigemptyset(&defaults);
+    sigaddset(&defaults, SIGINT);
+    sigaddset(&defaults, SIGTSTP);
+    sigaddset(&defaults, SIGTTOU);
+    posix_spawnattr_setsigdefault(&attr, &defaults);
+    /* The shell blocks SIGCHLD while it launches a job; the child must not. */
+    sigset_t mask;
+    sigemptyset(&mask);
+    posix_spawnattr_setsigmask(&attr, &mask);
+    posix_spawnattr_setpgroup(&attr, pgid);
+    posix_spawnattr_setflags(&attr,
+                             (shell_job_control ? POSIX_SPAWN_SETPGROUP : 0) |
+                                 POSIX_SPAWN_SETSIGDEF |
+                                 POSIX_SPAWN_SETSIGMASK);
+
+    pid_t pid;
+    int error = posix_spawn(&pid, p->program, &actions, &attr, p->argv,
+                            environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+    if (error != 0) {
+        fprintf(stderr, "%s: %s\n", p->argv[0], strerror(error));
+        /* The remembered path may be stale; search $PATH next time. */
+        path_cache_forget(p->argv[0]);
+        errno = error;
+        return -1;
+    }
+    return pid;
+}
+
+/* Puts job in the foreground, continuing it first if cont, and waits until
+ * all of its processes have ended or one has stopped. An ended job is
+ * forgotten. Returns the job's exit status. SIGCHLD must be blocked. */
+int wait_foreground(struct job *job, bool cont) {
+    bool stopped = job_state(job) == JOB_STOPPED;
+    job->background = false;
+    if (shell_is_interactive) {
+        tcsetpgrp(shell_terminal, job->pgid);
+        if (cont && stopped) {
+            tcsetattr(shell_terminal, TCSADRAIN, &job->tmodes);
+        }
+    }
+    if (cont) {
+        job_continue(job);
+    }
+
+    job_wait(job);
+
+    if (shell_is_interactive) {
+        tcsetpgrp(shell_terminal, shell_pgid); // take terminal back
+        tcgetattr(shell_terminal, &job->tmodes);
+        tcsetattr(shell_terminal, TCSADRAIN, &shell_tmodes);
+    }
+    int status = job_exit_status(job);
+    if (job_state(job) == JOB_STOPPED) {
+        printf("\n");
+        job_print(job);
+    } else {
+        job_free(job);
+    }
+    return status;
+}
+
+/* Runs the processes of a pipeline at the same time as one job, in one
+ * process group, each reading the output of the one before from a pipe. Waits
+ * for the job unless background is set. Returns the exit status of the job,
+ * 0 in the background, or that of the process that could not be started:
+ * 1 for a failed redirection, 127 for a missing program and 126 otherwise. */
+int run_pipeline(struct process *procs, int nprocs, const char *command,
+                 bool background) {
+    int in_fd = STDIN_FILENO;
+    int status = 0;
+
+    /* Children must not inherit output the shell has yet to write. */
+    fflush(stdout);
+
+    /* Until every process is in the table, the handler must not reap any. */
+    jobs_block();
+    struct job *job = job_create(command, nprocs, background);
+    if (job == NULL) {
+        fprintf(stderr, "%s: too many jobs\n", command);
+        jobs_unblock();
+        return 1;
+    }
+
+    for (int i = 0; i < nprocs; i++) {
+        struct process *p = &procs[i];
+        int pipefd[2] = {-1, STDOUT_FILENO};
+        if (i + 1 < nprocs && pipe2(pipefd, O_CLOEXEC) == -1) {
+            perror("pipe2");
+            status = 1;
+            break;
+        }
+
+        /* Redirections take the place of the pipes. */
+        int redir_in = -1, redir_out = -1;
+        pid_t pid = -1;
+        if (p->infile != NULL &&
+            (redir_in = open(p->infile, O_RDONLY | O_CLOEXEC)) == -1) {
+            perror(p->infile);
+            status = 1;
+        } else if (p->outfile != NULL &&
+                   (redir_out = open(p->outfile,
+                                     O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                                     0644)) == -1) {
+            perror(p->outfile);
+            status = 1;
+        } else {
+            int stage_in = redir_in != -1 ? redir_in : in_fd;
+            int stage_out = redir_out != -1 ? redir_out : pipefd[1];
+            if (p->fundex >= 0) {
+                pid = fork_builtin(p, job, stage_in, stage_out);
+            } else {
+                pid = spawn_process(p, job, stage_in, stage_out);
+            }
+            if (pid == -1) {
+                status = p->fundex < 0 && errno == ENOENT ? 127 : 126;
+            }
+        }
+
+        /* The children hold their own copies now. */
+        if (redir_in != -1) {
+            close(redir_in);
+        }
+        if (redir_out != -1) {
+            close(redir_out);
+        }
+        if (in_fd != STDIN_FILENO) {
+            close(in_fd);
+        }
+        if (pipefd[1] != STDOUT_FILENO) {
+            close(pipefd[1]);
+        }
+        in_fd = pipefd[0];
+        if (pid == -1) {
+            break;
+        }
+        job_add_process(job, pid);
+    }
+    if (in_fd != STDIN_FILENO && in_fd != -1) {
+        close(in_fd);
+    }
+
+    /* A pipeline cut short fails even if the processes started succeed. */
+    if (job->nprocs == 0) {
+        job_free(job);
+    } else if (background) {
+        if (shell_is_interactive) {
+            printf("[%d] %d\n", job->id, job->pgid);
+        }
+    } else {
+        int waited = wait_foreground(job, false);
+        status = status != 0 ? status : waited;
+    }
+    jobs_unblock();
+    return status;
+}
+
+/* Forgets background jobs that have ended, telling the user about them if
+ * interactive. SIGCHLD must be blocked. */
+void notify_job(struct job *job) {
+    if (job->background && job_state(job) == JOB_DONE) {
+        if (shell_is_interactive) {
+            job_print(job);
+        }
+        job_free(job);
+    }
+}
+
+
+/* Runs the processes of a parsed line: a built-in on its own in the shell
+ * itself, anything else as a job. command is the line, for job messages.
+ * Returns the exit status, which is 127 if a command is not found. */
+int run_line(struct process *procs, int nprocs, const char *command,
+             bool background) {
+    for (int i = 0; i < nprocs; i++) {
+        if (!resolve_process(&procs[i])) {
+            fprintf(stderr, "%s: command not found\n", procs[i].argv[0]);
+            return 127;
+        }
+    }
+
+    if (nprocs == 1 && procs[0].fundex >= 0 && !background) {
+        /* A built-in on its own runs in the shell itself. */
+        return cmd_table[procs[0].fundex].fun(procs[0].argv);
+    }
+    return run_pipeline(procs, nprocs, command, background);
+}
+
+/* Runs the nodes of a parsed script in order, with the loop variables in
+ * vars, leaving the status of the last command in shell_status. */
+void run_script(struct script_node *node, struct script_vars *vars) {
+    /* Expanded words, reused from one command to the next. */
+    static char *buf;
+    static size_t cap;
+
+    for (; node != NULL; node = node->next) {
+        if (node->type == SCRIPT_FOR) {
+            /* The values are expanded before the loop binds its variable. */
+            const char *values[node->nvalues + 1];
+            char *values_buf = NULL;
+            size_t values_cap = 0;
+            if (!node->expand) {
+                memcpy(values, node->values, node->nvalues * sizeof(char *));
+            } else if (script_expand_values(node, vars, values, &values_buf,
+                                            &values_cap) != 0) {
+                shell_status = 1;
+                continue;
+            }
+
+            /* A loop that runs nothing succeeds. */
+            shell_status = 0;
+            int depth = vars->n++;
+            vars->names[depth] = node->var;
+            for (int i = 0; i < node->nvalues; i++) {
+                vars->values[depth] = values[i];
+                run_script(node->body, vars);
+            }
+            vars->n--;
+            free(values_buf);
+        } else if (!node->expand) {
+            shell_status = run_line(node->procs, node->nprocs, node->text,
+                                    node->background);
+        } else {
+            char *words[node->nwords];
+            struct process procs[node->nprocs];
+            if (script_expand(node, vars, words, procs, &buf, &cap) == 0) {
+                shell_status = run_line(procs, node->nprocs, node->text,
+                                        node->background);
+            } else {
+                shell_status = 1;
+            }
+        }
+
+        jobs_block();
+        jobs_foreach(notify_job);
+        jobs_unblock();
+    }
+}
+
+/* Resolves the commands of a parsed script before it runs, so that running
+ * them, however often, needs no lookups. Commands named by a loop variable,
+ * or not found yet, are looked up when they run. */
+void resolve_script(struct script_node *node) {
+    for (; node != NULL; node = node->next) {
+        if (node->type == SCRIPT_FOR) {
+            resolve_script(node->body);
+            continue;
+        }
+        for (int i = 0; i < node->nprocs; i++) {
+            if (strchr(node->procs[i].argv[0], '$') == NULL) {
+                resolve_process(&node->procs[i]);
+            }
+        }
+    }
+}
+
+/* Reads all of file, or standard input if file is "-". Returns NULL after
+ * reporting an error. */
+char *read_script(const char *file) {
+    FILE *in = strcmp(file, "-") == 0 ? stdin : fopen(file, "r");
+    if (in == NULL) {
+        perror(file);
+        return NULL;
+    }
+    size_t len = 0, cap = 4096;
+    char *text = malloc(cap);
+    size_t n;
+    while (text != NULL && (n = fread(text + len, 1, cap - len - 1, in)) > 0) {
+        len += n;
+        if (cap - len == 1) {
+            char *grown = realloc(text, cap * 2);
+            if (grown == NULL) {
+                free(text);
+            }
+            text = grown;
+            cap *= 2;
+        }
+    }
+    if (text == NULL) {
+        perror("malloc");
+    } else if (ferror(in)) {
+        perror(file);
+        free(text);
+        text = NULL;
+    } else {
+        text[len] = '\0';
+    }
+    if (in != stdin) {
+        fclose(in);
+    }
+    return text;
+}
+
+/* Runs `shell -c COMMANDS` or `shell SCRIPT`: the whole script is parsed
+ * before any of it runs, without job control. Returns the status of the last
+ * command, or 2 if the script does not parse. */
+int run_batch(int argc, char *argv[]) {
+    char *text;
+    const char *name;
+    if (strcmp(argv[1], "-c") == 0 && argc == 3) {
+        text = strdup(argv[2]);
+        name = "-c";
+    } else if (argv[1][0] != '-' || strcmp(argv[1], "-") == 0) {
+        text = read_script(argv[1]);
+        name = argv[1];
+    } else {
+        fprintf(stderr, "usage: %s [-c COMMANDS | SCRIPT]\n", argv[0]);
+        return 2;
+    }
+    if (text == NULL) {
+        return 1;
+    }
+
+    shell_terminal = STDIN_FILENO;
+    shell_is_interactive = false;
+    shell_job_control = false;
+    jobs_init();
+
+    bool ok;
+    struct script *script = script_parse(text, name, &ok);
+    if (ok) {
+        struct script_vars vars = {.n = 0};
+        resolve_script(script->first);
+        run_script(script->first, &vars);
+    }
+    script_destroy(script);
+    free(text);
+    return ok ? shell_status : 2;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 1) {
+        return run_batch(argc, argv);
+    }
+
     init_shell();
 
     static char line[4096];
     int line_num = 0;
-    int pid;
 
     struct sigaction sa;
     sa.sa_handler = SIG_IGN;
@@ -142,7 +712,8 @@ int main(unused int argc, unused char *argv[]) {
     sigaction(SIGINT, &sa, NULL);
     sigaction(SIGTSTP, &sa, NULL);
     sigaction(SIGTTOU, &sa, NULL);
-    
+    jobs_init();
+
     /* Only print shell prompts when standard input is not a tty */
     if (shell_is_interactive) {
         fprintf(stdout, "%d: ", line_num);
@@ -151,114 +722,26 @@ int main(unused int argc, unused char *argv[]) {
     while (fgets(line, 4096, stdin)) {
         /* Split our line into words. */
         struct tokens *tokens = tokenize(line);
-
-        /* Find which built-in function to run. */
-        int fundex = lookup(tokens_get_token(tokens, 0));
-
-        if (fundex >= 0) {
-            cmd_table[fundex].fun(tokens);
-        } else {
-            /* REPLACE this to run commands as programs. */            
-            const char *path = getenv("PATH"); //for no explicit path
-            char *pathCopy = strdup(path);
-            char *dir = strtok(pathCopy, ":");
-
-            char *command = tokens_get_token(tokens, 0); //for explicit path
-            int size = tokens_get_length(tokens);
-            char *args[size + 1];
-
-            int inputFD = -1, outputFD = -1;    //input & output redirection
-            char *infile = NULL, *outfile = NULL;
-
-
-            for (int i = 0; i < size; i++){
-                args[i] = tokens_get_token(tokens, i);
-            }
-
-            args[size] = NULL;
-
-            //signal(SIGINT, SIG_IGN);
-            //signal(SIGTSTP, SIG_IGN);
-            //signal(SIGTTOU, SIG_IGN);
-
-            pid = fork(); 
-
-            if (pid == 0) { // child process
-                
-                struct sigaction sa_default;
-                sa_default.sa_handler = SIG_DFL;
-                sigemptyset(&sa_default.sa_mask);
-                sa_default.sa_flags = 0;
-                sigaction(SIGINT, &sa_default, NULL);
-                sigaction(SIGTSTP, &sa_default, NULL);
-                sigaction(SIGTTOU, &sa_default, NULL);
-                
-                //tcsetpgrp(shell_terminal, pid);
-                //signal(SIGINT, SIG_DFL);
-                //signal(SIGTSTP, SIG_DFL);
-
-                setpgid(0, 0); //since pid equals 0
-                tcsetpgrp(shell_terminal, getpid()); // child is in foreground
-               
-
-                for (int i = 0; i < size; i++){
-                    if ((strcmp(args[i], "<") == 0) && ((i+1) < size)){
-                        //Similarly, the syntax ”[process] < [file]” tells your shell to feed the contents of a file to the process’s standard input
-                        inputFD = i;
-                        infile = args[i+1];
-                        args[inputFD] = NULL;
-                    } else if ((strcmp(args[i], ">") == 0) && ((i+1) < size)){
-                        //The syntax “[process] > [file]” tells your shell to redirect the process’s standard output to a file. 
-                        outputFD = i;
-                        outfile = args[i + 1];
-                        args[outputFD] = NULL;
-                    }
-                }
-
-                if (infile != NULL) { //opening file for redirection
-                    int fd = open(infile, O_RDONLY);
-                    dup2(fd, STDIN_FILENO);
-                    close(fd);
-                }
-
-                if (outfile != NULL){ //opening file for redirection
-                    int fd = open(outfile, O_WRONLY | O_CREAT | O_TRUNC, 0644);
-                    dup2(fd, STDOUT_FILENO);
-                    close(fd);
-                }
-                
-                if (strchr(command, '/') != NULL) { //explicit path
-                    execv(command, args);
-                    exit(0);
-                } else {
-                    while (dir != NULL){ //no explicit path
-                        char pathVar[1024];
-                        snprintf(pathVar, sizeof(pathVar), "%s/%s", dir, command); //$PATH + command
-
-                        if (access(pathVar, X_OK) == 0) { //finding correct path
-                            execv(pathVar, args);
-                            exit(0);
-                        }
-                        dir = strtok(NULL, ":");
-                    }
-
-                    exit(1); //catch
-                } 
-                             
-            } else { // parent process
-                int status;
-                signal(SIGTTOU, SIG_IGN);
-                tcsetpgrp(shell_terminal, pid);
-                signal(SIGTTOU, SIG_DFL);
-
-                waitpid(pid, &status, 0);  //waiting for children to finish
-                tcsetpgrp(shell_terminal, shell_pgid); // take terminal back
-            }
-
-            free(pathCopy); //freeing memory from strdup
-        
+        size_t length = tokens_get_length(tokens);
+
+        /* Split the words into the commands of a pipeline. */
+        char *line_tokens[length + 1];
+        char *words[length + 1];
+        struct process procs[length + 1];
+        bool background;
+        for (size_t i = 0; i < length; i++) {
+            line_tokens[i] = tokens_get_token(tokens, i);
+        }
+        int nprocs = parse_pipeline(line_tokens, length, words, procs,
+                                    &background);
+        if (nprocs > 0) {
+            line[strcspn(line, "\n")] = '\0';
+            shell_status = run_line(procs, nprocs, line, background);
         }
-        
+
+        jobs_block();
+        jobs_foreach(notify_job);
+        jobs_unblock();
 
         if (shell_is_interactive) {
             /* Only print shell prompts when standard input is not a tty. */
@@ -268,5 +751,5 @@ int main(unused int argc, unused char *argv[]) {
         /* Clean up memory. */
         tokens_destroy(tokens);
     }
-    return 0;
+    return shell_status;
 }
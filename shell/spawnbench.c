@@ -0,0 +1,135 @@
+/* Measures how long the shell takes to launch a command and wait for it, with
+ * fork and execv as the shell used to, and with posix_spawn as it does now.
+ * fork copies the page tables of the whole process, so its cost grows with
+ * the memory the shell has touched; -m sets that memory for each round. */
+
+#include <errno.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+extern char **environ;
+
+#define MAX_SIZES 16
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [-n RUNS] [-m MIB,...] [PROGRAM [ARG]...]\n"
+            "Launches PROGRAM (default /bin/true) RUNS times per method with "
+            "MIB of\ntouched memory, and prints the mean latency of each "
+            "method.\n",
+            prog);
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Launches argv with fork and execv and waits for it. Returns 0 on success. */
+static int launch_fork(char **argv) {
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("fork");
+        return -1;
+    }
+    if (pid == 0) {
+        execv(argv[0], argv);
+        _exit(127);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : -1;
+}
+
+/* Launches argv with posix_spawn and waits for it. Returns 0 on success. */
+static int launch_spawn(char **argv) {
+    pid_t pid;
+    int error = posix_spawn(&pid, argv[0], NULL, NULL, argv, environ);
+    if (error != 0) {
+        fprintf(stderr, "posix_spawn: %s\n", strerror(error));
+        return -1;
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : -1;
+}
+
+/* Returns the mean seconds per launch over runs, or a negative value if a
+ * launch failed. */
+static double time_launches(int (*launch)(char **), char **argv, int runs) {
+    double start = now();
+    for (int i = 0; i < runs; i++) {
+        if (launch(argv) != 0) {
+            fprintf(stderr, "%s failed\n", argv[0]);
+            return -1;
+        }
+    }
+    return (now() - start) / runs;
+}
+
+int main(int argc, char *argv[]) {
+    int runs = 1000;
+    char *size_list = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "+n:m:")) != -1) {
+        switch (opt) {
+        case 'n':
+            runs = atoi(optarg);
+            break;
+        case 'm':
+            size_list = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (runs <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    char *true_argv[] = {"/bin/true", NULL};
+    char **command = optind < argc ? &argv[optind] : true_argv;
+
+    long sizes[MAX_SIZES];
+    int nsizes = 0;
+    if (size_list == NULL) {
+        sizes[nsizes++] = 0;
+    } else {
+        for (char *tok = strtok(size_list, ","); tok != NULL &&
+                                                 nsizes < MAX_SIZES;
+             tok = strtok(NULL, ",")) {
+            sizes[nsizes++] = atol(tok);
+        }
+    }
+
+    printf("mib\tfork_us\tspawn_us\tspeedup\n");
+    for (int i = 0; i < nsizes; i++) {
+        /* Touch every page, so fork has page tables to copy. */
+        size_t bytes = (size_t) sizes[i] * 1024 * 1024;
+        char *heap = malloc(bytes ? bytes : 1);
+        if (heap == NULL) {
+            perror("malloc");
+            return 1;
+        }
+        memset(heap, 1, bytes);
+
+        double fork_s = time_launches(launch_fork, command, runs);
+        double spawn_s = time_launches(launch_spawn, command, runs);
+        if (fork_s < 0 || spawn_s < 0) {
+            return 1;
+        }
+        printf("%ld\t%.1f\t%.1f\t%.2f\n", sizes[i], fork_s * 1e6,
+               spawn_s * 1e6, fork_s / spawn_s);
+        fflush(stdout);
+        free(heap);
+    }
+    return 0;
+}
@@ -25,15 +25,17 @@ static void *copy_word(char *source, size_t n) {
     return word;
 }
 
+static void push_word(char *word, size_t n, void *aux) {
+    struct tokens *tokens = aux;
+    vector_push(&tokens->tokens, &tokens->tokens_length, copy_word(word, n));
+}
+
 struct tokens *tokenize(const char *line) {
     if (line == NULL) {
         return NULL;
     }
 
-    static char token[4096];
-    size_t n = 0, n_max = 4096;
     struct tokens *tokens;
-    size_t line_length = strlen(line);
 
     tokens = (struct tokens *) malloc(sizeof(struct tokens));
     tokens->tokens_length = 0;
@@ -41,6 +43,15 @@ struct tokens *tokenize(const char *line) {
     tokens->buffers_length = 0;
     tokens->buffers = NULL;
 
+    tokenize_each(line, strlen(line), push_word, tokens);
+    return tokens;
+}
+
+void tokenize_each(const char *line, size_t line_length,
+                   void (*emit)(char *word, size_t n, void *aux), void *aux) {
+    static char token[4096];
+    size_t n = 0, n_max = 4096;
+
     const int MODE_NORMAL = 0, MODE_SQUOTE = 1, MODE_DQUOTE = 2;
     int mode = MODE_NORMAL;
 
@@ -57,8 +68,8 @@ struct tokens *tokenize(const char *line) {
                 }
             } else if (isspace(c)) {
                 if (n > 0) {
-                    void *word = copy_word(token, n);
-                    vector_push(&tokens->tokens, &tokens->tokens_length, word);
+                    token[n] = '\0';
+                    emit(token, n, aux);
                     n = 0;
                 }
             } else {
@@ -90,11 +101,10 @@ struct tokens *tokenize(const char *line) {
     }
 
     if (n > 0) {
-        void *word = copy_word(token, n);
-        vector_push(&tokens->tokens, &tokens->tokens_length, word);
+        token[n] = '\0';
+        emit(token, n, aux);
         n = 0;
     }
-    return tokens;
 }
 
 size_t tokens_get_length(struct tokens *tokens) {
@@ -9,6 +9,12 @@ struct tokens;
 /* Turn a string into a list of words. */
 struct tokens *tokenize(const char *line);
 
+/* Split the first len bytes of line into words like tokenize, but pass each
+ * word, NUL-terminated, and its length to emit along with aux instead of
+ * keeping it. The word is only valid during the call. */
+void tokenize_each(const char *line, size_t len,
+                   void (*emit)(char *word, size_t n, void *aux), void *aux);
+
 /* How many words are there? */
 size_t tokens_get_length(struct tokens *tokens);
 
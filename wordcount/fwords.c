@@ -23,91 +23,290 @@
  */
 
 #include <ctype.h>
+#include <errno.h>
+#include <getopt.h>
+#include <poll.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
 #include "word_count.h"
 #include "word_helpers.h"
+#include "word_io.h"
+#include "word_prefetch.h"
+
+/* Size of each child's pipe buffer in the parent. */
+#define PIPE_BUFFER_SIZE (64 * 1024)
+
+/* A running child and the unmerged bytes it has sent so far. */
+typedef struct {
+    pid_t pid;
+    const char *filename;
+    int fd;
+    char *buf;
+    size_t have;
+    size_t cap;
+} child_t;
+
+/* Read input through word_prefetch streams (--prefetch). */
+static bool prefetch = false;
 
 /*
- * Read stream of counts and accumulate globally.
+ * Forks a child that counts filename and writes its counts to a pipe.
+ * The child closes the pipes of the other running children.
+ * Returns 0 on success.
  */
+static int start_child(child_t *child, const char *filename,
+                       child_t *children, int nchildren) {
+    int pipefd[2];
+    if (pipe(pipefd) == -1) {
+        perror("pipe failed");
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("fork");
+        close(pipefd[0]);
+        close(pipefd[1]);
+        return -1;
+    }
+
+    if (pid == 0) { // child process
+        close(pipefd[0]); //not using it
+        for (int i = 0; i < nchildren; i++) {
+            if (children[i].pid != 0) {
+                close(children[i].fd);
+            }
+        }
+        FILE *file = prefetch_open_input(filename, prefetch);
+        if (file == NULL) {
+            perror(filename);
+            exit(1);
+        }
+        word_count_list_t locallist;
+        init_words_with_arena(&locallist);
+        count_words(&locallist, file);
+        fclose(file);
+
+        FILE *printStream = fdopen(pipefd[1], "w"); //child writes binary counts to this one
+        int rv = write_counts_binary(&locallist, printStream, false);
+        fclose(printStream);
+        exit(rv == 0 ? 0 : 1);
+    }
 
-void merge_counts(word_count_list_t *wclist, FILE *count_stream) {
-    char *word;
-    int count;
-    int rv;
-    while ((rv = fscanf(count_stream, "%8d\t%ms\n", &count, &word)) == 2) {
-        add_word_with_count(wclist, word, count);
+    // parent process
+    close(pipefd[1]); // not using it
+    child->pid = pid;
+    child->filename = filename;
+    child->fd = pipefd[0];
+    child->have = 0;
+    return 0;
+}
+
+/*
+ * Reads what a child has written so far and merges every complete record.
+ * Returns false once the child has closed its pipe.
+ */
+static bool drain_child(word_count_list_t *wclist, child_t *child) {
+    if (child->have == child->cap) {
+        /* A single record is larger than the buffer. */
+        char *grown = realloc(child->buf, child->cap * 2);
+        if (grown == NULL) {
+            perror("realloc");
+            return false;
+        }
+        child->buf = grown;
+        child->cap *= 2;
     }
-    if ((rv == EOF) && (feof(count_stream) == 0)) {
+
+    ssize_t n = read(child->fd, child->buf + child->have,
+                     child->cap - child->have);
+    if (n < 0 && errno == EINTR) {
+        return true;
+    } else if (n < 0) {
         perror("could not read counts");
-    } else if (rv != EOF) {
-        fprintf(stderr, "read ill-formed count (matched %d)\n", rv);
+        return false;
+    } else if (n == 0) {
+        if (child->have != 0) {
+            fprintf(stderr, "read ill-formed counts (%zu trailing bytes)\n",
+                    child->have);
+        }
+        return false;
     }
+
+    child->have += n;
+    size_t used = merge_counts_buffer(wclist, child->buf, child->have);
+    memmove(child->buf, child->buf + used, child->have - used);
+    child->have -= used;
+    return true;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [-j N] [--prefetch] [--top K] [--utf8] [--ngram N] "
+            "[FILE]...\n",
+            prog);
 }
 
 /*
- * main - handle command line, spawning one process per file.
+ * main - handle command line, counting each file in its own process. Up to
+ * -j processes (default: online CPUs) run at once, and the parent merges
+ * their counts as they arrive.
  */
 int main(int argc, char *argv[]) {
+    static const struct option long_options[] = {
+        {"jobs", required_argument, NULL, 'j'},
+        {"top", required_argument, NULL, 'k'},
+        {"utf8", no_argument, NULL, 'u'},
+        {"prefetch", no_argument, NULL, 'p'},
+        {"ngram", required_argument, NULL, 'n'},
+        {NULL, 0, NULL, 0},
+    };
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t top = 0;
+    bool failed = false;
+    int opt;
+    while ((opt = getopt_long(argc, argv, "j:k:upn:", long_options, NULL)) !=
+           -1) {
+        switch (opt) {
+        case 'k':
+            if ((top = strtoul(optarg, NULL, 10)) == 0) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'u':
+            if (!use_utf8_words()) {
+                return 1;
+            }
+            break;
+        case 'p':
+            prefetch = true;
+            break;
+        case 'n':
+            if (!use_ngrams(atoi(optarg))) {
+                return 1;
+            }
+            break;
+        case 'j':
+            if ((jobs = strtol(optarg, NULL, 10)) <= 0) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (jobs <= 0) {
+        jobs = 1;
+    }
+
     /* Create the empty data structure. */
     word_count_list_t word_counts;
-    init_words(&word_counts);
-    int bound = argc - 1; //1 = self
-    int pipefd[2];
+    init_words_with_arena(&word_counts);
+    int nfiles = argc - optind;
 
-    
-
-    if (argc <= 1) {
+    if (nfiles == 0) {
         /* Process stdin in a single process. */
-        count_words(&word_counts, stdin);
+        FILE *infile = prefetch_open_input(NULL, prefetch);
+        if (infile == NULL) {
+            perror("stdin");
+            exit(1);
+        }
+        count_words(&word_counts, infile);
+        if (infile != stdin) {
+            fclose(infile);
+        }
     } else {
-        //pipe, parent writes file name
-
-        int pid;
-
-        for (int i = 0; i < bound; i++){
-
-            if (pipe(pipefd) == -1) {
-                perror("pipe failed");
+        int nchildren = jobs < nfiles ? jobs : nfiles;
+        child_t *children = calloc(nchildren, sizeof(child_t));
+        struct pollfd *fds = calloc(nchildren, sizeof(struct pollfd));
+        if (children == NULL || fds == NULL) {
+            perror("calloc");
+            exit(1);
+        }
+        for (int i = 0; i < nchildren; i++) {
+            children[i].cap = PIPE_BUFFER_SIZE;
+            if ((children[i].buf = malloc(PIPE_BUFFER_SIZE)) == NULL) {
+                perror("malloc");
                 exit(1);
             }
+        }
 
-            pid = fork(); //no error, error squiggles are being dramatic today
-
-           
-            if (pid == 0) { // child process
-                close(pipefd[0]); //not using it
-                FILE *file = fopen(argv[i + 1], "r");
-                word_count_list_t locallist;
-                init_words(&locallist);
-                count_words(&locallist, file);
-                FILE *printStream = fdopen(pipefd[1], "w"); //child writes result from fprint to this one
-                fprint_words(&locallist, printStream);
-
-                fclose(printStream);
-                fclose(file);
+        int next = 0;
+        int running = 0;
+        while (next < nfiles || running > 0) {
+            /* Keep every slot busy while files remain. */
+            for (int i = 0; i < nchildren && next < nfiles; i++) {
+                if (children[i].pid == 0) {
+                    if (start_child(&children[i], argv[optind + next],
+                                    children, nchildren) != 0) {
+                        exit(1);
+                    }
+                    next++;
+                    running++;
+                }
+            }
 
-                exit(0);
-            } else { // parent process
-                close(pipefd[1]); // not using it
-                FILE *mergeReadStream = fdopen(pipefd[0], "r"); //parent reads what child wrote
-                merge_counts(&word_counts, mergeReadStream);
+            int nfds = 0;
+            for (int i = 0; i < nchildren; i++) {
+                if (children[i].pid != 0) {
+                    fds[nfds].fd = children[i].fd;
+                    fds[nfds].events = POLLIN;
+                    nfds++;
+                }
+            }
+            if (poll(fds, nfds, -1) == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                perror("poll");
+                exit(1);
+            }
 
-                fclose(mergeReadStream);  
+            for (int i = 0, k = 0; i < nchildren; i++) {
+                if (children[i].pid == 0) {
+                    continue;
+                }
+                short revents = fds[k++].revents;
+                if (revents == 0 || drain_child(&word_counts, &children[i])) {
+                    continue;
+                }
+                /* The child is done; reap it and free the slot. */
+                int status;
+                close(children[i].fd);
+                waitpid(children[i].pid, &status, 0);
+                if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                    fprintf(stderr, "%s: counting failed\n",
+                            children[i].filename);
+                    failed = true;
+                }
+                children[i].pid = 0;
+                running--;
             }
+        }
 
+        for (int i = 0; i < nchildren; i++) {
+            free(children[i].buf);
         }
-        
+        free(children);
+        free(fds);
     }
 
     /* Output final result of all process' work. */
-    wordcount_sort(&word_counts, less_count);
-    fprint_words(&word_counts, stdout);
-    return 0;
+    if (top > 0) {
+        fprint_top_words(&word_counts, stdout, top);
+    } else {
+        wordcount_sort_parallel(&word_counts, less_count, jobs);
+        fprint_words(&word_counts, stdout);
+    }
+    return failed ? 1 : 0;
 }
@@ -1,9 +1,10 @@
 /*
- * Word count application with one thread per input file.
+ * Word count application with a bounded pool of worker threads.
  *
- * You may modify this file in any way you like, and are expected to modify it.
- * Your solution must read each input file from a separate thread. We encourage
- * you to make as few changes as necessary.
+ * At most --threads workers are started, never more than there are files.
+ * Each worker claims input files from a shared queue one at a time and counts
+ * them into a table of its own, which it merges into the shared table once the
+ * queue is empty.
  */
 
 /*
@@ -23,113 +24,590 @@
  */
 
 #include <ctype.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <limits.h>
 #include <pthread.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "word_count.h"
 #include "word_helpers.h"
+#include "word_prefetch.h"
+#include "word_size.h"
+#include "word_spill.h"
+#include "word_stats.h"
 
 #define NUM_THREADS 4
 int common = 162;
 char *somethingshared;
 
+/*
+ * Input files shared by the worker pool. Workers claim the next file by
+ * atomically incrementing next, so no lock is needed to hand out work.
+ *
+ * With --mem-budget, spill is set and workers write their tables to spill
+ * whenever they hold more than budget bytes, instead of merging into
+ * sharedWordCount. failed is set once any file could not be opened, and
+ * spill_failed once a table could not be spilled, which loses its counts.
+ */
 typedef struct {
-    char* filename;
-    pthread_mutex_t *localLock;
+    char **filenames;
+    int nfiles;
+    int next;
     word_count_list_t *sharedWordCount;
-} threadData;
+    struct word_spill *spill;
+    size_t budget;
+    bool failed;
+    bool spill_failed;
+} fileQueue;
+
+#ifdef HASH_TABLE
+/* Shard count for the shared and per-thread tables (--shards). */
+static size_t nshards = 64;
+#endif
+
+/* Read input through word_prefetch streams (--prefetch). */
+static bool prefetch = false;
 
 /*
- * main - handle command line, spawning one thread per file.
+ * Initializes a table compatible with the shared one for merge_words, with
+ * entries allocated from arenas.
  */
+static void init_local_words(word_count_list_t *wclist) {
+#ifdef HASH_TABLE
+    init_words_sharded(wclist, nshards, true);
+#else
+    init_words_with_arena(wclist);
+#endif
+}
+
+#ifdef WORDS_STATS
+/* Counters of one thread, kept in start order for the summary. */
+struct thread_record {
+    struct word_stats stats;
+    struct thread_record *next;
+};
+
+static struct thread_record *records;
+static struct thread_record **records_tail = &records;
+static pthread_mutex_t records_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Prints the counters of every thread, and their totals, to stderr. */
+static void print_stats(void) {
+    struct word_stats total = {0};
+    fprintf(stderr, "%6s %12s %10s %10s %10s %10s %10s\n", "thread", "bytes",
+            "words", "count_ms", "wait_ms", "hold_ms", "merged");
+    int i = 0;
+    for (struct thread_record *rec = records; rec != NULL; rec = rec->next) {
+        struct word_stats *s = &rec->stats;
+        fprintf(stderr, "%6d %12" PRIu64 " %10" PRIu64 " %10.1f %10.1f %10.1f "
+                "%10" PRIu64 "\n", i++, s->bytes, s->words, s->count_ns / 1e6,
+                s->merge_wait_ns / 1e6, s->merge_hold_ns / 1e6,
+                s->merge_entries);
+        total.bytes += s->bytes;
+        total.words += s->words;
+        total.count_ns += s->count_ns;
+        total.merge_wait_ns += s->merge_wait_ns;
+        total.merge_hold_ns += s->merge_hold_ns;
+        total.merge_entries += s->merge_entries;
+    }
+    fprintf(stderr, "%6s %12" PRIu64 " %10" PRIu64 " %10.1f %10.1f %10.1f "
+            "%10" PRIu64 "\n", "total", total.bytes, total.words,
+            total.count_ns / 1e6, total.merge_wait_ns / 1e6,
+            total.merge_hold_ns / 1e6, total.merge_entries);
+}
+#endif /* WORDS_STATS */
 
-void *threadInit(void* argument) {
-    
-    threadData *data = (threadData*)argument;
-
-    //printf("Opening File: %s\n", data->filename);
-  //  int myid = pthread_self();
-   // printf("Thread ID: %d\n", myid);
-   // printf("Thread for %s started\n", data->filename);
-   // sleep(3); 
 /*
-    if (!data || !data->filename) {
-       // fprintf(stderr, "Invalid thread data or filename\n");
-        pthread_exit(NULL);
-    } */
+ * Starts recording the calling thread's work in its own counters, when built
+ * with WORDS_STATS.
+ */
+static void stats_begin(void) {
+#ifdef WORDS_STATS
+    struct thread_record *rec = calloc(1, sizeof(struct thread_record));
+    if (rec == NULL) {
+        perror("calloc");
+        return;
+    }
+    pthread_mutex_lock(&records_lock);
+    if (records == NULL) {
+        atexit(print_stats);
+    }
+    *records_tail = rec;
+    records_tail = &rec->next;
+    pthread_mutex_unlock(&records_lock);
+    thread_stats = &rec->stats;
+#endif
+}
 
-    FILE *file = fopen(data->filename, "r");
-    /*
-    if (!file) {
-        perror("File open error");
-        pthread_exit(NULL);  
+/* Spills the table, recording in queue whether that failed. */
+static bool spill_or_fail(fileQueue *queue, word_count_list_t *wclist) {
+    if (spill_words(queue->spill, wclist) != 0) {
+        __atomic_store_n(&queue->spill_failed, true, __ATOMIC_RELAXED);
+        return false;
+    }
+    return true;
+}
+
+/*
+ * count_words_blocks callback: spills the table once it is over budget. Stops
+ * the count once any spill has failed.
+ */
+static bool spill_if_full(word_count_list_t *wclist, void *aux) {
+    fileQueue *queue = (fileQueue *) aux;
+    if (__atomic_load_n(&queue->spill_failed, __ATOMIC_RELAXED)) {
+        return false;
+    }
+    if (mem_words(wclist) < queue->budget) {
+        return true;
+    }
+    return spill_or_fail(queue, wclist);
+}
+
+/*
+ * Pool worker: counts files claimed from the queue into one thread-local
+ * table, then merges it into the shared table once all files are taken.
+ * merge_words does its own locking, so workers only contend while merging
+ * into the same part of the shared table.
+ */
+void *threadInit(void* argument) {
+    fileQueue *queue = (fileQueue*)argument;
+    stats_begin();
+
+    word_count_list_t locallist;
+    init_local_words(&locallist);
+
+    int i;
+    while (!__atomic_load_n(&queue->spill_failed, __ATOMIC_RELAXED) &&
+           (i = __atomic_fetch_add(&queue->next, 1, __ATOMIC_RELAXED)) <
+           queue->nfiles) {
+        FILE *file = prefetch_open_input(queue->filenames[i], prefetch);
+        if (file == NULL) {
+            perror(queue->filenames[i]);
+            __atomic_store_n(&queue->failed, true, __ATOMIC_RELAXED);
+            continue;
+        }
+        STATS_START(count_start);
+        if (queue->spill != NULL) {
+            count_words_blocks(&locallist, file, spill_if_full, queue);
+        } else {
+            count_words(&locallist, file);
+        }
+        STATS_ADD_TIME(count_ns, count_start);
+        fclose(file);
     }
-*/
+
+    if (queue->spill != NULL) {
+        if (!__atomic_load_n(&queue->spill_failed, __ATOMIC_RELAXED)) {
+            spill_or_fail(queue, &locallist);
+        }
+    } else {
+        merge_words(queue->sharedWordCount, &locallist);
+    }
+    destroy_words(&locallist);
+    return NULL;
+}
+
+typedef struct {
+    const char *buf;
+    size_t len;
+    word_count_list_t *sharedWordCount;
+} chunkData;
+
+/* Counts one word-aligned chunk of a mapped file, then merges it. */
+void *chunkInit(void *argument) {
+    chunkData *data = (chunkData *) argument;
+    stats_begin();
+
     word_count_list_t locallist;
-    init_words(&locallist);
-    count_words(&locallist, file);
-    fclose(file);
-
-    pthread_mutex_lock(data->localLock);
-    //critical section, adding local data to shared list
-   // printf("In critical section, Thread ID: %d\n", myid);
-    struct list *ptr = &locallist.lst;
-    struct list_elem *wc = list_begin(ptr);
-    for (wc = list_begin(ptr); wc != list_end(ptr); wc = list_next(wc)){
-        word_count_t *element = list_entry(wc, word_count_t, elem);
-        word_count_t *newElement = add_word(data->sharedWordCount, element->word);
-        int count = element->count; 
-        for (int i = 1; i < count; i++ ){
-            newElement->count = newElement->count + 1;
-        }
-    }
-    pthread_mutex_unlock(data->localLock);
+    init_local_words(&locallist);
+    STATS_START(count_start);
+    count_words_buffer(&locallist, data->buf, data->len);
+    STATS_ADD_TIME(count_ns, count_start);
+
+    merge_words(data->sharedWordCount, &locallist);
+    destroy_words(&locallist);
     return NULL;
+}
+
+/*
+ * Maps a file and counts it with nthreads workers, each taking a contiguous
+ * byte range whose ends have been moved forward to word boundaries.
+ * Returns 0 on success.
+ */
+static int count_file_split(word_count_list_t *wclist, const char *filename,
+                            int nthreads) {
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1) {
+        perror("open");
+        return 1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        perror("fstat");
+        close(fd);
+        return 1;
+    }
+    size_t len = st.st_size;
+    if (len == 0) {
+        close(fd);
+        return 0;
+    }
+    char *buf = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (buf == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    madvise(buf, len, MADV_SEQUENTIAL);
+
+    chunkData *chunks = calloc(nthreads, sizeof(chunkData));
+    pthread_t *threads = calloc(nthreads, sizeof(pthread_t));
+    if (chunks == NULL || threads == NULL) {
+        perror("calloc");
+        free(chunks);
+        free(threads);
+        munmap(buf, len);
+        return 1;
+    }
+
+    size_t start = 0;
+    int nchunks = 0;
+    for (int i = 0; i < nthreads && start < len; i++) {
+        size_t end = word_boundary(buf, len, len / nthreads * (i + 1));
+        if (i == nthreads - 1) {
+            end = len;
+        }
+        if (end <= start) {
+            continue;
+        }
+        chunks[nchunks].buf = buf + start;
+        chunks[nchunks].len = end - start;
+        chunks[nchunks].sharedWordCount = wclist;
+        pthread_create(&threads[nchunks], NULL, chunkInit, &chunks[nchunks]);
+        nchunks++;
+        start = end;
+    }
+    for (int i = 0; i < nchunks; i++) {
+        pthread_join(threads[i], NULL);
+    }
 
+    free(chunks);
+    free(threads);
+    munmap(buf, len);
+    return 0;
 }
 
+static void usage(const char *prog) {
+#ifdef HASH_TABLE
+    fprintf(stderr,
+            "usage: %s [--shards N] [--split | --prefetch] [--threads N] "
+            "[--top K] [--utf8]\n"
+            "          [--ngram N] [FILE]...\n"
+            "       %s [--shards N] [--prefetch] [--threads N] [--top K] "
+            "[--utf8]\n"
+            "          [--ngram N] --mem-budget BYTES [FILE]...\n",
+            prog, prog);
+#else
+    fprintf(stderr,
+            "usage: %s [--split | --prefetch] [--threads N] [--top K] [--utf8] "
+            "[--ngram N]\n"
+            "          [FILE]...\n"
+            "       %s [--prefetch] [--threads N] [--top K] [--utf8] "
+            "[--ngram N]\n"
+            "          --mem-budget BYTES [FILE]...\n",
+            prog, prog);
+#endif
+    fprintf(stderr, "With --mem-budget, tables larger than BYTES (K, M or G "
+                    "suffix) in total are\nspilled to $TMPDIR and the counts "
+                    "are printed in alphabetical order, or by\ncount with "
+                    "--top.\n"
+                    "With --prefetch, each input is read ahead by a thread of "
+                    "its own.\nWith --ngram, runs of N consecutive words are "
+                    "counted instead of words; --split\ncannot be used, as it "
+                    "would lose the n-grams spanning each chunk.\n");
+}
 
+static void print_spilled(const char *word, uint64_t count, void *aux) {
+    printf("%8" PRIu64 "\t%s\n", count, word);
+}
 
+/*
+ * spill_merge emit function for --top: keeps the word in a top_heap if it
+ * ranks among the highest counts so far, so only K words are held at once.
+ * Each entry is malloc'd with its word right behind it.
+ */
+static void offer_spilled(const char *word, uint64_t count, void *aux) {
+    struct top_heap *heap = (struct top_heap *) aux;
+    /* Counts are ints in every word_count_t. */
+    int n = count > INT_MAX ? INT_MAX : (int) count;
+    word_count_t probe = {.word = (char *) word, .count = n};
+    if (!top_heap_admits(heap, &probe)) {
+        return;
+    }
+    size_t size = strlen(word) + 1;
+    word_count_t *wc = malloc(sizeof(word_count_t) + size);
+    if (wc == NULL) {
+        perror("malloc");
+        return;
+    }
+    *wc = probe;
+    wc->word = memcpy(wc + 1, word, size);
+    free(top_heap_offer(heap, wc));
+}
+
+/*
+ * Counts the input with every worker spilling its table to disk whenever it
+ * exceeds its share of budget, then merges the runs and prints the counts,
+ * or only the top ones if top is nonzero. Prints nothing if any spill
+ * failed, as the counts would be incomplete. Returns 0 on success.
+ */
+static int count_spilled(char **filenames, int nfiles, long nworkers,
+                         size_t budget, size_t top) {
+    struct word_spill spill;
+    spill_init(&spill, NULL);
+    fileQueue queue = {filenames, nfiles, 0, NULL, &spill, budget, false,
+                       false};
+
+    if (nfiles == 0) {
+        FILE *infile = prefetch_open_input(NULL, prefetch);
+        if (infile == NULL) {
+            perror("stdin");
+            spill_destroy(&spill);
+            return 1;
+        }
+        word_count_list_t word_counts;
+        init_local_words(&word_counts);
+        stats_begin();
+        STATS_START(count_start);
+        count_words_blocks(&word_counts, infile, spill_if_full, &queue);
+        STATS_ADD_TIME(count_ns, count_start);
+        if (infile != stdin) {
+            fclose(infile);
+        }
+        if (!queue.spill_failed) {
+            spill_or_fail(&queue, &word_counts);
+        }
+        destroy_words(&word_counts);
+    } else {
+        int nthreads = nworkers < nfiles ? nworkers : nfiles;
+        pthread_t *threads = calloc(nthreads, sizeof(pthread_t));
+        if (threads == NULL) {
+            perror("calloc");
+            spill_destroy(&spill);
+            return 1;
+        }
+        /* Tables grow concurrently, so each gets a share of the budget. */
+        queue.budget = budget / nthreads;
+        for (int i = 0; i < nthreads; i++) {
+            pthread_create(&threads[i], NULL, threadInit, &queue);
+        }
+        for (int i = 0; i < nthreads; i++) {
+            pthread_join(threads[i], NULL);
+        }
+        free(threads);
+    }
+
+    if (queue.spill_failed) {
+        spill_destroy(&spill);
+        return 1;
+    }
+    int status;
+    if (top > 0) {
+        struct top_heap heap;
+        if (!top_heap_init(&heap, top)) {
+            spill_destroy(&spill);
+            return 1;
+        }
+        status = spill_merge(&spill, offer_spilled, &heap);
+        if (status != 0) {
+            /* Top counts of a merge cut short would be wrong. */
+            for (size_t i = 0; i < heap.size; i++) {
+                free(heap.entries[i]);
+            }
+            heap.size = 0;
+        }
+        fprint_top_heap(&heap, stdout, true);
+    } else {
+        status = spill_merge(&spill, print_spilled, NULL);
+    }
+    spill_destroy(&spill);
+    return status == 0 && !queue.failed ? 0 : 1;
+}
 
+/*
+ * Prints all counts, or only the top ones if top is nonzero, sorting on up to
+ * nthreads threads.
+ */
+static void print_counts(word_count_list_t *wclist, size_t top,
+                         long nthreads) {
+    if (top > 0) {
+        fprint_top_words(wclist, stdout, top);
+    } else {
+        wordcount_sort_parallel(wclist, less_count, nthreads);
+        fprint_words(wclist, stdout);
+    }
+}
 
+/*
+ * main - handle command line, counting files on a pool of worker threads.
+ */
 int main(int argc, char *argv[]) {
+    static const struct option long_options[] = {
+        {"shards", required_argument, NULL, 's'},
+        {"split", no_argument, NULL, 'S'},
+        {"threads", required_argument, NULL, 't'},
+        {"top", required_argument, NULL, 'k'},
+        {"mem-budget", required_argument, NULL, 'm'},
+        {"utf8", no_argument, NULL, 'u'},
+        {"prefetch", no_argument, NULL, 'p'},
+        {"ngram", required_argument, NULL, 'n'},
+        {NULL, 0, NULL, 0},
+    };
+    bool split = false;
+    bool ngrams = false;
+    size_t top = 0;
+    size_t budget = 0;
+    long nworkers = sysconf(_SC_NPROCESSORS_ONLN);
+    int opt;
+    while ((opt = getopt_long(argc, argv, "s:St:k:m:upn:", long_options,
+                              NULL)) != -1) {
+        switch (opt) {
+        case 'k':
+            if ((top = strtoul(optarg, NULL, 10)) == 0) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'm':
+            if ((budget = parse_size(optarg)) == 0) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        case 'S':
+            split = true;
+            break;
+        case 'p':
+            prefetch = true;
+            break;
+        case 'n':
+            if (!use_ngrams(atoi(optarg))) {
+                return 1;
+            }
+            ngrams = true;
+            break;
+        case 'u':
+            if (!use_utf8_words()) {
+                return 1;
+            }
+            break;
+        case 't':
+            if ((nworkers = strtol(optarg, NULL, 10)) <= 0) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+#ifdef HASH_TABLE
+        case 's':
+            if ((nshards = strtoul(optarg, NULL, 10)) == 0) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+#endif
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (nworkers <= 0) {
+        nworkers = 1;
+    }
+
+    /*
+     * Split files are mapped, so there is nothing to prefetch, and each
+     * chunk would lose the n-grams spanning its start.
+     */
+    if (split && (prefetch || ngrams)) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (budget > 0) {
+        if (split) {
+            usage(argv[0]);
+            return 1;
+        }
+        return count_spilled(argv + optind, argc - optind, nworkers, budget,
+                             top);
+    }
+
     /* Create the empty data structure. */
     word_count_list_t word_counts;
-    init_words(&word_counts);
+    init_local_words(&word_counts);
 
-    int nthreads = argc - 1;
-    threadData tArgs[nthreads];
-    pthread_t threads[nthreads];
-    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
-    
+    if (split && optind < argc) {
+        /* Process files one at a time, each split across all workers. */
+        for (int i = optind; i < argc; i++) {
+            if (count_file_split(&word_counts, argv[i], nworkers) != 0) {
+                return 1;
+            }
+        }
+        print_counts(&word_counts, top, nworkers);
+        destroy_words(&word_counts);
+        return 0;
+    }
 
-    if (argc <= 1) {
-        count_words(&word_counts, stdin);
+    bool failed = false;
+    int nfiles = argc - optind;
+    if (nfiles == 0) {
+        FILE *infile = prefetch_open_input(NULL, prefetch);
+        if (infile == NULL) {
+            perror("stdin");
+            return 1;
+        }
+        stats_begin();
+        STATS_START(count_start);
+        count_words(&word_counts, infile);
+        STATS_ADD_TIME(count_ns, count_start);
+        if (infile != stdin) {
+            fclose(infile);
+        }
     } else {
-        for (int i = 0; i < nthreads; i++){
-            tArgs[i].filename = argv[i + 1];
-            tArgs[i].sharedWordCount = &word_counts;
-            tArgs[i].localLock = &lock;
-            pthread_create(&threads[i], NULL, threadInit, &tArgs[i]);
+        /* Never start more workers than there are files. */
+        int nthreads = nworkers < nfiles ? nworkers : nfiles;
+        pthread_t *threads = calloc(nthreads, sizeof(pthread_t));
+        if (threads == NULL) {
+            perror("calloc");
+            return 1;
+        }
 
-            //printf(tArgs[i].filename);
+        fileQueue queue = {argv + optind, nfiles, 0, &word_counts, NULL, 0,
+                           false, false};
+        for (int i = 0; i < nthreads; i++) {
+            pthread_create(&threads[i], NULL, threadInit, &queue);
         }
-    }
 
-    // Output final result of all threads' work. 
+        // Output final result of all threads' work. 
 
-    for (int i = 0; i < nthreads; i++) {
-        pthread_join(threads[i], NULL);
+        for (int i = 0; i < nthreads; i++) {
+            pthread_join(threads[i], NULL);
+        }
+        free(threads);
+        failed = queue.failed;
     }
 
-    wordcount_sort(&word_counts, less_count);
-    fprint_words(&word_counts, stdout);
-
-    pthread_exit(NULL);
+    print_counts(&word_counts, top, nworkers);
+    destroy_words(&word_counts);
 
-    return 0;
+    return failed ? 1 : 0;
 
 }
@@ -0,0 +1,325 @@
+/*
+ * Benchmark driver for the word count tools. Runs each tool over the given
+ * input files at each requested thread count and writes one CSV row per
+ * run with throughput, peak memory and scaling efficiency.
+ */
+
+/*
+ * Copyright (C) 2019 University of California, Berkeley
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/* A tool under test and the flag that sets its parallelism, if any. */
+typedef struct {
+    const char *name;
+    const char *thread_flag;
+} tool_t;
+
+static const tool_t known_tools[] = {
+    {"words", NULL},  {"lwords", NULL},  {"mwords", NULL}, {"hwords", NULL},
+    {"pwords", "-t"}, {"hpwords", "-t"}, {"fwords", "-j"},
+};
+
+#define MAX_THREAD_COUNTS 32
+#define MAX_EXTRA_ARGS 16
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [-b TOOL,...] [-t N,...] [-r REPS] [-l LABEL] "
+            "[-o CSV [-a]] [-c] [-x ARG]...\n"
+            "          FILE...\n"
+            "Tools default to every word count binary in the current "
+            "directory.\nLABEL names the corpus in the CSV; -a appends to "
+            "CSV. -c drops FILEs from the\npage cache before every run, and "
+            "each -x passes ARG to every tool.\n",
+            prog);
+}
+
+static const tool_t *find_tool(const char *name) {
+    for (size_t i = 0; i < sizeof(known_tools) / sizeof(tool_t); i++) {
+        if (strcmp(known_tools[i].name, name) == 0) {
+            return &known_tools[i];
+        }
+    }
+    return NULL;
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Asks the kernel to drop the cached pages of files, so the next run reads
+ * them from disk. Only clean pages are dropped; a file written just before
+ * the benchmark should be synced first.
+ */
+static void drop_cache(char **files, int nfiles) {
+    for (int i = 0; i < nfiles; i++) {
+        int fd = open(files[i], O_RDONLY);
+        if (fd == -1) {
+            perror(files[i]);
+            continue;
+        }
+        fdatasync(fd);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+}
+
+/*
+ * Runs ./tool over files, after the extra arguments, with its output
+ * discarded. Returns the wall-clock
+ * time in seconds and stores the child's peak RSS in *rss_kb, or returns a
+ * negative value if the run failed.
+ */
+static double run_tool(const tool_t *tool, int threads, char **extra,
+                       int nextra, char **files, int nfiles, long *rss_kb) {
+    char path[256];
+    char nthreads[16];
+    snprintf(path, sizeof(path), "./%s", tool->name);
+    snprintf(nthreads, sizeof(nthreads), "%d", threads);
+
+    char **args = calloc(nextra + nfiles + 4, sizeof(char *));
+    if (args == NULL) {
+        perror("calloc");
+        return -1;
+    }
+    int n = 0;
+    args[n++] = path;
+    if (tool->thread_flag != NULL) {
+        args[n++] = (char *) tool->thread_flag;
+        args[n++] = nthreads;
+    }
+    memcpy(&args[n], extra, nextra * sizeof(char *));
+    n += nextra;
+    memcpy(&args[n], files, nfiles * sizeof(char *));
+
+    double start = now();
+    pid_t pid = fork();
+    if (pid == 0) {
+        int devnull = open("/dev/null", O_WRONLY);
+        dup2(devnull, STDOUT_FILENO);
+        execv(path, args);
+        perror(path);
+        _exit(127);
+    }
+    free(args);
+    if (pid == -1) {
+        perror("fork");
+        return -1;
+    }
+
+    int status;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) == -1) {
+        perror("wait4");
+        return -1;
+    }
+    double elapsed = now() - start;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "%s failed\n", tool->name);
+        return -1;
+    }
+    *rss_kb = usage.ru_maxrss;
+    return elapsed;
+}
+
+int main(int argc, char *argv[]) {
+    const char *tool_list = NULL;
+    char *thread_list = NULL;
+    const char *csv_path = NULL;
+    const char *label = "input";
+    bool append = false;
+    bool cold = false;
+    char *extra[MAX_EXTRA_ARGS];
+    int nextra = 0;
+    int reps = 3;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "b:t:r:l:o:acx:")) != -1) {
+        switch (opt) {
+        case 'b':
+            tool_list = optarg;
+            break;
+        case 't':
+            thread_list = optarg;
+            break;
+        case 'r':
+            reps = atoi(optarg);
+            break;
+        case 'l':
+            label = optarg;
+            break;
+        case 'o':
+            csv_path = optarg;
+            break;
+        case 'a':
+            append = true;
+            break;
+        case 'c':
+            cold = true;
+            break;
+        case 'x':
+            if (nextra == MAX_EXTRA_ARGS) {
+                usage(argv[0]);
+                return 1;
+            }
+            extra[nextra++] = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (optind >= argc || reps <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    char **files = &argv[optind];
+    int nfiles = argc - optind;
+
+    int thread_counts[MAX_THREAD_COUNTS];
+    int nthread_counts = 0;
+    if (thread_list == NULL) {
+        thread_counts[nthread_counts++] = 1;
+    } else {
+        for (char *tok = strtok(thread_list, ","); tok != NULL &&
+                                                   nthread_counts <
+                                                       MAX_THREAD_COUNTS;
+             tok = strtok(NULL, ",")) {
+            if ((thread_counts[nthread_counts] = atoi(tok)) > 0) {
+                nthread_counts++;
+            }
+        }
+    }
+
+    double bytes = 0;
+    for (int i = 0; i < nfiles; i++) {
+        struct stat st;
+        if (stat(files[i], &st) == -1) {
+            perror(files[i]);
+            return 1;
+        }
+        bytes += st.st_size;
+    }
+
+    FILE *csv = stdout;
+    if (csv_path != NULL) {
+        /* Only write the header when starting a new file. */
+        struct stat st;
+        append = append && stat(csv_path, &st) == 0 && st.st_size > 0;
+        if ((csv = fopen(csv_path, append ? "a" : "w")) == NULL) {
+            perror(csv_path);
+            return 1;
+        }
+    }
+    if (!append) {
+        fprintf(csv, "corpus,tool,threads,input_bytes,seconds,mb_per_s,"
+                     "peak_rss_kb,efficiency\n");
+    }
+
+    char *tools = strdup(tool_list != NULL ? tool_list : "");
+    const tool_t *selected[sizeof(known_tools) / sizeof(tool_t)];
+    size_t nselected = 0;
+    if (tool_list == NULL) {
+        /* Every tool that has been built. */
+        for (size_t i = 0; i < sizeof(known_tools) / sizeof(tool_t); i++) {
+            if (access(known_tools[i].name, X_OK) == 0) {
+                selected[nselected++] = &known_tools[i];
+            }
+        }
+    } else {
+        for (char *tok = strtok(tools, ","); tok != NULL &&
+                                             nselected <
+                                                 sizeof(known_tools) /
+                                                     sizeof(tool_t);
+             tok = strtok(NULL, ",")) {
+            const tool_t *tool = find_tool(tok);
+            if (tool == NULL) {
+                fprintf(stderr, "unknown tool %s\n", tok);
+                return 1;
+            }
+            selected[nselected++] = tool;
+        }
+    }
+
+    int status = 0;
+    for (size_t t = 0; t < nselected; t++) {
+        const tool_t *tool = selected[t];
+        double base = 0;
+        for (int c = 0; c < nthread_counts; c++) {
+            int threads = tool->thread_flag != NULL ? thread_counts[c] : 1;
+            if (tool->thread_flag == NULL && c > 0) {
+                break;
+            }
+
+            /* Report the fastest of reps runs and the largest RSS seen. */
+            double best = -1;
+            long peak = 0;
+            for (int r = 0; r < reps; r++) {
+                long rss = 0;
+                if (cold) {
+                    drop_cache(files, nfiles);
+                }
+                double elapsed = run_tool(tool, threads, extra, nextra, files,
+                                          nfiles, &rss);
+                if (elapsed < 0) {
+                    best = -1;
+                    break;
+                }
+                if (best < 0 || elapsed < best) {
+                    best = elapsed;
+                }
+                if (rss > peak) {
+                    peak = rss;
+                }
+            }
+            if (best < 0) {
+                status = 1;
+                continue;
+            }
+
+            /* Efficiency is speedup over the first thread count per thread. */
+            if (c == 0) {
+                base = best * threads;
+            }
+            fprintf(csv, "%s,%s,%d,%.0f,%.4f,%.2f,%ld,%.3f\n", label,
+                    tool->name, threads, bytes, best,
+                    bytes / best / (1024 * 1024), peak,
+                    base / (best * threads));
+            fflush(csv);
+        }
+    }
+
+    free(tools);
+    if (csv != stdout) {
+        fclose(csv);
+    }
+    return status;
+}
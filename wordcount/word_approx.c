@@ -0,0 +1,313 @@
+/*
+ * Implementation of the word_approx interface.
+ */
+
+/*
+ * Copyright (C) 2019 University of California, Berkeley
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "word_approx.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Euler's number, which sets the Count-Min error bounds. */
+#define E 2.718281828459045
+
+/*
+ * Counter of word in a sketch row. The rows use the hashes h1 + row * h2,
+ * which are as good as independent ones for Count-Min.
+ */
+static size_t sketch_slot(const struct word_approx *approx, uint64_t hash,
+                          size_t row) {
+    uint64_t h2 = ((hash * 0x9e3779b97f4a7c15ULL) >> 32) | 1;
+    return row * approx->width + ((hash + row * h2) & (approx->width - 1));
+}
+
+/*
+ * Adds count to the sketch with the conservative update: counters are only
+ * raised as far as the new estimate, which keeps them upper bounds while
+ * adding less noise to other words.
+ */
+static void sketch_add(struct word_approx *approx, uint64_t hash,
+                       uint64_t count) {
+    uint64_t estimate = UINT64_MAX;
+    for (size_t row = 0; row < approx->depth; row++) {
+        uint64_t c = approx->sketch[sketch_slot(approx, hash, row)];
+        if (c < estimate) {
+            estimate = c;
+        }
+    }
+    estimate += count;
+    for (size_t row = 0; row < approx->depth; row++) {
+        uint64_t *c = &approx->sketch[sketch_slot(approx, hash, row)];
+        if (*c < estimate) {
+            *c = estimate;
+        }
+    }
+}
+
+static uint64_t sketch_estimate(const struct word_approx *approx,
+                                uint64_t hash) {
+    uint64_t estimate = UINT64_MAX;
+    for (size_t row = 0; row < approx->depth; row++) {
+        uint64_t c = approx->sketch[sketch_slot(approx, hash, row)];
+        if (c < estimate) {
+            estimate = c;
+        }
+    }
+    return estimate;
+}
+
+/*
+ * Returns the index slot holding word, or the empty slot where it would be
+ * inserted. Linear probing; the index is never more than half full.
+ */
+static size_t index_probe(const struct word_approx *approx, const char *word,
+                          uint64_t hash) {
+    size_t i = hash & approx->index_mask;
+    while (approx->index[i] != 0) {
+        const struct approx_item *item = &approx->items[approx->index[i] - 1];
+        if (item->hash == hash && strcmp(item->word, word) == 0) {
+            break;
+        }
+        i = (i + 1) & approx->index_mask;
+    }
+    return i;
+}
+
+/* Empties an index slot, moving later entries of its probe run back. */
+static void index_remove(struct word_approx *approx, size_t slot) {
+    size_t mask = approx->index_mask;
+    size_t i = slot;
+    for (size_t j = (i + 1) & mask; approx->index[j] != 0;
+         j = (j + 1) & mask) {
+        struct approx_item *item = &approx->items[approx->index[j] - 1];
+        size_t home = item->hash & mask;
+        /* Fill the hole at i unless the entry's home lies in (i, j]. */
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            approx->index[i] = approx->index[j];
+            item->slot = i;
+            i = j;
+        }
+    }
+    approx->index[i] = 0;
+}
+
+/* Puts an item at heap position pos, keeping its index entry current. */
+static void heap_place(struct word_approx *approx, size_t pos,
+                       struct approx_item item) {
+    approx->items[pos] = item;
+    approx->index[item.slot] = pos + 1;
+}
+
+static void heap_sift_up(struct word_approx *approx, size_t pos) {
+    struct approx_item item = approx->items[pos];
+    while (pos > 0) {
+        size_t parent = (pos - 1) / 2;
+        if (approx->items[parent].count <= item.count) {
+            break;
+        }
+        heap_place(approx, pos, approx->items[parent]);
+        pos = parent;
+    }
+    heap_place(approx, pos, item);
+}
+
+static void heap_sift_down(struct word_approx *approx, size_t pos) {
+    struct approx_item item = approx->items[pos];
+    for (;;) {
+        size_t child = 2 * pos + 1;
+        if (child >= approx->nitems) {
+            break;
+        }
+        if (child + 1 < approx->nitems &&
+            approx->items[child + 1].count < approx->items[child].count) {
+            child++;
+        }
+        if (item.count <= approx->items[child].count) {
+            break;
+        }
+        heap_place(approx, pos, approx->items[child]);
+        pos = child;
+    }
+    heap_place(approx, pos, item);
+}
+
+int approx_init(struct word_approx *approx, size_t width, size_t depth,
+                size_t capacity) {
+    size_t w = 1;
+    while (w < width) {
+        w *= 2;
+    }
+    size_t slots = 1;
+    while (slots < 2 * capacity) {
+        slots *= 2;
+    }
+    approx->width = w;
+    approx->depth = depth;
+    approx->total = 0;
+    approx->nitems = 0;
+    approx->capacity = capacity;
+    approx->index_mask = slots - 1;
+    approx->sketch = calloc(w * depth, sizeof(uint64_t));
+    approx->items = calloc(capacity, sizeof(struct approx_item));
+    approx->index = calloc(slots, sizeof(size_t));
+    if (approx->sketch == NULL || approx->items == NULL ||
+        approx->index == NULL) {
+        perror("calloc");
+        approx_destroy(approx);
+        return -1;
+    }
+    return 0;
+}
+
+int approx_add(struct word_approx *approx, const char *word, uint64_t count) {
+    uint64_t hash = hash_key(word);
+    sketch_add(approx, hash, count);
+    approx->total += count;
+
+    size_t slot = index_probe(approx, word, hash);
+    if (approx->index[slot] != 0) {
+        size_t pos = approx->index[slot] - 1;
+        approx->items[pos].count += count;
+        heap_sift_down(approx, pos);
+        return 0;
+    }
+
+    char *copy = strdup(word);
+    if (copy == NULL) {
+        perror("strdup");
+        return -1;
+    }
+    struct approx_item item = {copy, hash, count, 0, slot};
+    if (approx->nitems < approx->capacity) {
+        approx->nitems++;
+        heap_place(approx, approx->nitems - 1, item);
+        heap_sift_up(approx, approx->nitems - 1);
+        return 0;
+    }
+
+    /*
+     * Space-Saving: the new word takes over the least counted one, whose
+     * count it inherits as possible error.
+     */
+    struct approx_item *min = &approx->items[0];
+    index_remove(approx, min->slot);
+    free(min->word);
+    item.count += min->count;
+    item.error = min->count;
+    item.slot = index_probe(approx, word, hash);
+    heap_place(approx, 0, item);
+    heap_sift_down(approx, 0);
+    return 0;
+}
+
+struct add_state {
+    struct word_approx *approx;
+    int status;
+};
+
+/* wordcount_foreach callback: adds one entry to the estimator. */
+static void add_entry(word_count_t *wc, void *aux) {
+    struct add_state *state = aux;
+    if (state->status == 0) {
+        state->status = approx_add(state->approx, wc->word, wc->count);
+    }
+}
+
+int approx_add_words(struct word_approx *approx, word_count_list_t *wclist) {
+    struct add_state state = {approx, 0};
+    wordcount_foreach(wclist, add_entry, &state);
+    return state.status;
+}
+
+uint64_t approx_estimate(const struct word_approx *approx, const char *word) {
+    uint64_t hash = hash_key(word);
+    uint64_t estimate = sketch_estimate(approx, hash);
+    size_t slot = index_probe(approx, word, hash);
+    if (approx->index[slot] != 0) {
+        uint64_t count = approx->items[approx->index[slot] - 1].count;
+        if (count < estimate) {
+            estimate = count;
+        }
+    }
+    return estimate;
+}
+
+/* An item with its final estimate, for sorting the report. */
+struct ranked_item {
+    const struct approx_item *item;
+    uint64_t estimate;
+};
+
+/* qsort comparator: ascending estimates, ties broken by word. */
+static int compare_ranked(const void *a, const void *b) {
+    const struct ranked_item *ra = a, *rb = b;
+    if (ra->estimate != rb->estimate) {
+        return ra->estimate < rb->estimate ? -1 : 1;
+    }
+    return strcmp(ra->item->word, rb->item->word);
+}
+
+void approx_print_top(struct word_approx *approx, FILE *outfile,
+                      FILE *errfile, size_t k) {
+    size_t n = approx->nitems;
+    struct ranked_item *ranked = calloc(n ? n : 1, sizeof(struct ranked_item));
+    if (ranked == NULL) {
+        perror("calloc");
+        return;
+    }
+    for (size_t i = 0; i < n; i++) {
+        const struct approx_item *item = &approx->items[i];
+        uint64_t estimate = sketch_estimate(approx, item->hash);
+        ranked[i].item = item;
+        ranked[i].estimate = item->count < estimate ? item->count : estimate;
+    }
+    qsort(ranked, n, sizeof(struct ranked_item), compare_ranked);
+
+    for (size_t i = n > k ? n - k : 0; i < n; i++) {
+        const struct approx_item *item = ranked[i].item;
+        fprintf(outfile, "%8" PRIu64 "\t%s\t%" PRIu64 "\n", ranked[i].estimate,
+                item->word, item->count - item->error);
+    }
+    free(ranked);
+
+    /* The bounds promised by approx_init. */
+    double miss = 1;
+    for (size_t i = 0; i < approx->depth; i++) {
+        miss /= E;
+    }
+    fprintf(errfile,
+            "%" PRIu64 " words counted approximately. Estimates are at most "
+            "%" PRIu64 " too high\nwith probability %.4f, and no word seen "
+            "more than %" PRIu64 " times is missed.\n",
+            approx->total, (uint64_t) (E * approx->total / approx->width) + 1,
+            1 - miss, approx->total / approx->capacity);
+}
+
+void approx_destroy(struct word_approx *approx) {
+    for (size_t i = 0; i < approx->nitems; i++) {
+        free(approx->items[i].word);
+    }
+    free(approx->sketch);
+    free(approx->items);
+    free(approx->index);
+    approx->sketch = NULL;
+    approx->items = NULL;
+    approx->index = NULL;
+    approx->nitems = 0;
+}
@@ -0,0 +1,95 @@
+/*
+ * The word_approx interface estimates word counts in fixed memory, for
+ * streams whose vocabulary is too large to count exactly. A Count-Min
+ * sketch bounds the count of every word from above, and a Space-Saving
+ * summary keeps the words that may be the most frequent, so the top words
+ * can be reported with bounds on how far off their counts are.
+ */
+
+/*
+ * Copyright (C) 2019 University of California, Berkeley
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef WORD_APPROX_H
+#define WORD_APPROX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "word_count.h"
+
+/* A word monitored by the Space-Saving summary. */
+struct approx_item {
+    char *word;
+    uint64_t hash;
+    uint64_t count; /* Never less than the word's true count. */
+    uint64_t error; /* Most of count that may belong to evicted words. */
+    size_t slot;    /* Position in the index. */
+};
+
+struct word_approx {
+    uint64_t *sketch; /* depth rows of width counters. */
+    size_t width;
+    size_t depth;
+    uint64_t total; /* Sum of all counts added. */
+
+    /* Monitored words, as a min-heap on count. */
+    struct approx_item *items;
+    size_t nitems;
+    size_t capacity;
+
+    /* Open-addressing table of heap positions plus one; 0 if empty. */
+    size_t *index;
+    size_t index_mask;
+};
+
+/*
+ * Initializes an estimator with a width x depth sketch, where width is
+ * rounded up to a power of two, that monitors up to capacity words. Every
+ * estimate then exceeds the true count by at most e / width of the total
+ * count, except with probability e^-depth, and every word making up more
+ * than 1 / capacity of the total is monitored. Memory use stays fixed from
+ * here on. Returns 0 on success, -1 if out of memory.
+ */
+int approx_init(struct word_approx *approx, size_t width, size_t depth,
+                size_t capacity);
+
+/* Adds count occurrences of word. Returns 0 on success, -1 on error. */
+int approx_add(struct word_approx *approx, const char *word, uint64_t count);
+
+/*
+ * Adds the counts of every entry of a word count list, e.g. one holding the
+ * exact counts of the latest block of input. Returns 0 on success, -1 on
+ * error.
+ */
+int approx_add_words(struct word_approx *approx, word_count_list_t *wclist);
+
+/* Returns an upper bound on the count of word. */
+uint64_t approx_estimate(const struct word_approx *approx, const char *word);
+
+/*
+ * Prints the k monitored words with the highest estimates in the order of
+ * fprint_top_words. Each line holds the estimate, the word and a lower bound
+ * on its true count, separated by tabs. The error bound of the estimates is
+ * printed to errfile.
+ */
+void approx_print_top(struct word_approx *approx, FILE *outfile,
+                      FILE *errfile, size_t k);
+
+/* Frees the memory held by an estimator. */
+void approx_destroy(struct word_approx *approx);
+
+#endif /* WORD_APPROX_H */
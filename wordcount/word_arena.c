@@ -0,0 +1,170 @@
+/*
+ * Implementation of the word_arena interface.
+ */
+
+/*
+ * Copyright (C) 2019 University of California, Berkeley
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "word_arena.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Usable size of a regular block. Larger requests get a block of their own. */
+#define BLOCK_SIZE (64 * 1024)
+
+/* Alignment of every allocation. */
+#define ALIGN 8
+
+struct word_arena_block {
+    struct word_arena_block *next;
+    /* Followed by the block's data. */
+};
+
+/* Size of the block header, rounded up so block data stays aligned. */
+#define HEADER_SIZE                                                            \
+    ((sizeof(struct word_arena_block) + ALIGN - 1) & ~(size_t) (ALIGN - 1))
+
+struct word_arena *arena_create(void) {
+    struct word_arena *arena = malloc(sizeof(struct word_arena));
+    if (arena == NULL) {
+        perror("malloc");
+        return NULL;
+    }
+    arena->blocks = NULL;
+    arena->next = NULL;
+    arena->limit = NULL;
+    arena->used = 0;
+    return arena;
+}
+
+void *arena_alloc(struct word_arena *arena, size_t size) {
+    size = (size + ALIGN - 1) & ~(size_t) (ALIGN - 1);
+    if (size > (size_t) (arena->limit - arena->next)) {
+        size_t data_size = size > BLOCK_SIZE ? size : BLOCK_SIZE;
+        struct word_arena_block *block = malloc(HEADER_SIZE + data_size);
+        if (block == NULL) {
+            perror("malloc");
+            return NULL;
+        }
+        char *data = (char *) block + HEADER_SIZE;
+        if (data_size > BLOCK_SIZE && arena->blocks != NULL) {
+            /*
+             * Keep bumping through the current block; the oversized one is
+             * only used for this allocation.
+             */
+            block->next = arena->blocks->next;
+            arena->blocks->next = block;
+            arena->used += size;
+            return data;
+        }
+        block->next = arena->blocks;
+        arena->blocks = block;
+        arena->next = data;
+        arena->limit = data + data_size;
+    }
+
+    void *p = arena->next;
+    arena->next += size;
+    arena->used += size;
+    return p;
+}
+
+char *arena_strdup(struct word_arena *arena, const char *str) {
+    size_t len = strlen(str) + 1;
+    char *copy = arena_alloc(arena, len);
+    if (copy != NULL) {
+        memcpy(copy, str, len);
+    }
+    return copy;
+}
+
+void *arena_new_entry(struct word_arena *arena, size_t entry_size,
+                      const char *word, bool copy) {
+    void *entry;
+    char *owned;
+    if (arena != NULL) {
+        size_t len = strlen(word) + 1;
+        if ((entry = arena_alloc(arena, entry_size + len)) == NULL) {
+            return NULL;
+        }
+        owned = memcpy((char *) entry + entry_size, word, len);
+        if (!copy) {
+            free((char *) word);
+        }
+    } else {
+        owned = (char *) word;
+        if (copy && (owned = strdup(word)) == NULL) {
+            perror("strdup");
+            return NULL;
+        }
+        if ((entry = malloc(entry_size)) == NULL) {
+            perror("malloc");
+            if (copy) {
+                free(owned);
+            }
+            return NULL;
+        }
+    }
+    /* The word field comes first in every word_count_t. */
+    *(char **) entry = owned;
+    return entry;
+}
+
+void arena_adopt(struct word_arena *arena, struct word_arena *from) {
+    if (from->blocks == NULL) {
+        return;
+    }
+    if (arena->blocks == NULL) {
+        *arena = *from;
+    } else {
+        /* Keep bumping through arena's current block. */
+        struct word_arena_block *last = from->blocks;
+        while (last->next != NULL) {
+            last = last->next;
+        }
+        last->next = arena->blocks->next;
+        arena->blocks->next = from->blocks;
+        arena->used += from->used;
+    }
+    from->blocks = NULL;
+    from->next = NULL;
+    from->limit = NULL;
+    from->used = 0;
+}
+
+void arena_reset(struct word_arena *arena) {
+    struct word_arena_block *block = arena->blocks;
+    while (block != NULL) {
+        struct word_arena_block *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->blocks = NULL;
+    arena->next = NULL;
+    arena->limit = NULL;
+    arena->used = 0;
+}
+
+void arena_destroy(struct word_arena *arena) {
+    if (arena == NULL) {
+        return;
+    }
+    arena_reset(arena);
+    free(arena);
+}
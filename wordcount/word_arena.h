@@ -0,0 +1,72 @@
+/*
+ * The word_arena interface is a bump-pointer allocator for word count
+ * entries and their strings. Allocations are never freed individually; the
+ * whole arena is released at once.
+ */
+
+/*
+ * Copyright (C) 2019 University of California, Berkeley
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef WORD_ARENA_H
+#define WORD_ARENA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct word_arena_block;
+
+struct word_arena {
+    struct word_arena_block *blocks; /* Most recent block first. */
+    char *next;                      /* Next free byte in blocks. */
+    char *limit;                     /* End of blocks. */
+    size_t used;                     /* Bytes handed out so far. */
+};
+
+/* Allocates and initializes an empty arena. Returns NULL on failure. */
+struct word_arena *arena_create(void);
+
+/*
+ * Returns size bytes aligned for any word_count_t, or NULL if out of
+ * memory.
+ */
+void *arena_alloc(struct word_arena *arena, size_t size);
+
+/* Copies a NUL-terminated string into the arena. */
+char *arena_strdup(struct word_arena *arena, const char *str);
+
+/*
+ * Allocates an entry of entry_size bytes for a word count table and sets its
+ * word field, which every word_count_t starts with. From an arena, word is
+ * copied right behind the entry, and freed unless copy is set. If arena is
+ * NULL, the entry is malloc'd and takes ownership of word, or of a malloc'd
+ * copy if copy is set. Returns NULL if out of memory.
+ */
+void *arena_new_entry(struct word_arena *arena, size_t entry_size,
+                      const char *word, bool copy);
+
+/*
+ * Moves every allocation of from into arena, leaving from empty. Lets a
+ * table take over the entries of another without copying them.
+ */
+void arena_adopt(struct word_arena *arena, struct word_arena *from);
+
+/* Frees every allocation in the arena, leaving it empty for reuse. */
+void arena_reset(struct word_arena *arena);
+
+/* Frees every allocation in the arena, and the arena itself. */
+void arena_destroy(struct word_arena *arena);
+
+#endif /* WORD_ARENA_H */
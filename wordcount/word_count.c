@@ -22,84 +22,139 @@
  */
 
 #include "word_count.h"
+#include "word_sort.h"
 
 void init_words(word_count_list_t *wclist) {
     /* Initialize word count.  */
-    *wclist = NULL;
+    wclist->head = NULL;
+    wclist->arena = NULL;
+    wclist->bytes = 0;
+}
+
+void init_words_with_arena(word_count_list_t *wclist) {
+    init_words(wclist);
+    wclist->arena = arena_create();
+}
+
+void free_words(word_count_list_t *wclist) {
+    if (wclist->arena != NULL) {
+        arena_reset(wclist->arena);
+    } else {
+        word_count_t *wc = wclist->head;
+        while (wc != NULL) {
+            word_count_t *next = wc->next;
+            free(wc->word);
+            free(wc);
+            wc = next;
+        }
+    }
+    wclist->head = NULL;
+    wclist->bytes = 0;
+}
+
+void destroy_words(word_count_list_t *wclist) {
+    free_words(wclist);
+    arena_destroy(wclist->arena);
+    wclist->arena = NULL;
 }
 
 size_t len_words(word_count_list_t *wclist) {
     size_t len = 0;
     word_count_t *cur;
-    for (cur = *wclist; cur != NULL; cur = cur->next) {
+    for (cur = wclist->head; cur != NULL; cur = cur->next) {
         len++;
     }
     return len;
 }
 
+size_t mem_words(word_count_list_t *wclist) {
+    return wclist->arena != NULL ? wclist->arena->used : wclist->bytes;
+}
+
 word_count_t *find_word(word_count_list_t *wclist, char *word) {
     /* Return count for word, if it exists. */
-    word_count_t *wc = *wclist;
+    word_count_t *wc = wclist->head;
     while ((wc != NULL) && (strcmp(word, wc->word) != 0)) {
         wc = wc->next;
     }
     return wc;
 }
 
-word_count_t *add_word(word_count_list_t *wclist, char *word) {
-    /*
-     * If word is present in word_counts list, increment the count.
-     * Otherwise, insert at head of list with count 1.
-     */
-    word_count_t *wc = find_word(wclist, word);
+/*
+ * If word is present in word_counts list, add count to it. Otherwise,
+ * insert at head of list with count.
+ */
+static word_count_t *add(word_count_list_t *wclist, const char *word,
+                         int count, bool copy) {
+    word_count_t *wc = find_word(wclist, (char *) word);
     if (wc != NULL) {
-        wc->count++;
-    } else if ((wc = malloc(sizeof(word_count_t))) != NULL) {
-        wc->word = word;
-        wc->count = 1;
-        wc->next = *wclist;
-        *wclist = wc;
-    } else {
-        perror("malloc");
+        wc->count += count;
+    } else if ((wc = arena_new_entry(wclist->arena, sizeof(word_count_t),
+                                     word, copy)) != NULL) {
+        wclist->bytes += entry_bytes(wc);
+        wc->count = count;
+        wc->next = wclist->head;
+        wclist->head = wc;
     }
     return wc;
 }
 
-void fprint_words(word_count_list_t *wclist, FILE *outfile) {
+word_count_t *add_word(word_count_list_t *wclist, char *word) {
+    return add(wclist, word, 1, false);
+}
+
+word_count_t *add_word_with_count(word_count_list_t *wclist, char *word,
+                                  int count) {
+    return add(wclist, word, count, false);
+}
+
+word_count_t *add_word_copy(word_count_list_t *wclist, const char *word,
+                            int count) {
+    return add(wclist, word, count, true);
+}
+
+word_count_t *add_word_copy_hashed(word_count_list_t *wclist,
+                                   const char *word, uint64_t hash,
+                                   int count) {
+    return add(wclist, word, count, true);
+}
+
+void wordcount_foreach(word_count_list_t *wclist,
+                       void fn(word_count_t *wc, void *aux), void *aux) {
     word_count_t *wc;
-    for (wc = *wclist; wc != NULL; wc = wc->next) {
-        fprintf(outfile, "%8d\t%s\n", wc->count, wc->word);
+    for (wc = wclist->head; wc != NULL; wc = wc->next) {
+        fn(wc, aux);
     }
 }
 
-void wordcount_insert_ordered(word_count_list_t *wclist, word_count_t *elem,
-                              bool less(const word_count_t *,
-                                        const word_count_t *)) {
-    word_count_t *prev = *wclist;
-    if (prev == NULL || less(elem, prev)) {
-        elem->next = prev;
-        *wclist = elem;
-    } else {
-        word_count_t *cur = prev->next;
-        while (cur != NULL && less(cur, elem)) {
-            prev = cur;
-            cur = prev->next;
-        }
-        prev->next = elem;
-        elem->next = cur;
+void fprint_words(word_count_list_t *wclist, FILE *outfile) {
+    word_count_t *wc;
+    for (wc = wclist->head; wc != NULL; wc = wc->next) {
+        fprintf(outfile, "%8d\t%s\n", wc->count, wc->word);
     }
 }
 
 void wordcount_sort(word_count_list_t *wclist,
                     bool less(const word_count_t *, const word_count_t *)) {
-    word_count_t *head = *wclist;
-    word_count_list_t sorted;
-    init_words(&sorted);
-    while (head != NULL) {
-        word_count_t *to_insert = head;
-        head = head->next;
-        to_insert->next = NULL;
-        wordcount_insert_ordered(&sorted, to_insert, less);
+    wclist->head = sort_chain(wclist->head, len_words(wclist),
+                              offsetof(word_count_t, next), less);
+}
+
+void wordcount_sort_parallel(word_count_list_t *wclist,
+                             bool less(const word_count_t *,
+                                       const word_count_t *),
+                             int nthreads) {
+    word_count_t **entries = sort_words(wclist, less, nthreads);
+    if (entries == NULL) {
+        wordcount_sort(wclist, less);
+        return;
+    }
+
+    size_t n = len_words(wclist);
+    for (size_t i = 0; i + 1 < n; i++) {
+        entries[i]->next = entries[i + 1];
     }
-    *wclist = sorted;
+    entries[n - 1]->next = NULL;
+    wclist->head = entries[0];
+    free(entries);
 }
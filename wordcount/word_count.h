@@ -27,17 +27,77 @@
 #include <ctype.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "word_arena.h"
+
 /*
  * Representation of a word count object and word count list object.
- * PINTOS_LIST and/or PTHREADS are #define'd prior to #include to select the
- * representations.
+ * HASH_TABLE, PINTOS_LIST and/or PTHREADS are #define'd prior to #include to
+ * select the representations.
+ *
+ * Every representation starts with the word and count fields so that code
+ * compiled without these flags (e.g. word_helpers.c) can access them.
+ *
+ * Lists initialized with init_words_with_arena allocate entries and words
+ * from an arena they own; otherwise arena is NULL and each entry and word is
+ * malloc'd separately, with bytes keeping the total of their sizes for
+ * mem_words.
+ */
+
+#ifdef HASH_TABLE
+#include <stdint.h>
+typedef struct word_count {
+    char *word;
+    int count;
+    uint64_t hash;
+    struct word_count *next;
+} word_count_t;
+
+#ifdef PTHREADS
+#include <pthread.h>
+/*
+ * One lock-protected open-addressing table. A word always lives in the shard
+ * selected by the high bits of its hash.
+ */
+typedef struct word_count_shard {
+    word_count_t **slots;
+    size_t capacity;
+    size_t size;
+    pthread_mutex_t lock;
+    struct word_arena *arena;
+    size_t bytes;
+} word_count_shard_t;
+
+/*
+ * Hash table split into independently locked shards so that concurrent
+ * inserts and merges only contend when they touch the same shard. head is
+ * the list built by wordcount_sort, and is cleared by any insertion.
  */
+typedef struct word_count_list {
+    word_count_shard_t *shards;
+    size_t nshards;
+    word_count_t *head;
+} word_count_list_t;
+#else /* PTHREADS */
+/*
+ * Open-addressing hash table keyed by word. Entries are also threaded onto a
+ * singly-linked list so they can be printed and sorted in place.
+ */
+typedef struct word_count_list {
+    word_count_t **slots;
+    size_t capacity;
+    size_t size;
+    word_count_t *head;
+    struct word_arena *arena;
+    size_t bytes;
+} word_count_list_t;
+#endif /* PTHREADS */
 
-#ifdef PINTOS_LIST
+#elif defined(PINTOS_LIST)
 #include "list.h"
 typedef struct word_count {
     char *word;
@@ -50,12 +110,40 @@ typedef struct word_count {
 typedef struct word_count_list {
     struct list lst;
     pthread_mutex_t lock;
+    struct word_arena *arena;
+    size_t bytes;
 } word_count_list_t;
 #else /* PTHREADS */
-typedef struct list word_count_list_t;
+#ifdef HOT_CACHE
+#include <stdint.h>
+/* Number of entries in the hot array of a list. */
+#define HOT_ENTRIES 32
+
+/* Reference to a list entry, with enough cached to reject most mismatches. */
+struct word_count_hot {
+    uint32_t hash;
+    uint32_t len;
+    struct word_count *wc;
+};
+#endif /* HOT_CACHE */
+
+/*
+ * With HOT_CACHE, lookups first scan hot, a small array of frequently used
+ * entries, before walking the list, and the list is kept ordered by
+ * decreasing count so that the walk finds common words early.
+ */
+typedef struct word_count_list {
+    struct list lst;
+    struct word_arena *arena;
+    size_t bytes;
+#ifdef HOT_CACHE
+    struct word_count_hot hot[HOT_ENTRIES];
+    size_t nhot;
+#endif /* HOT_CACHE */
+} word_count_list_t;
 #endif /* PTHREADS */
 
-#else /* PINTOS_LIST */
+#else /* HASH_TABLE, PINTOS_LIST */
 
 typedef struct word_count {
     char *word;
@@ -63,15 +151,48 @@ typedef struct word_count {
     struct word_count *next;
 } word_count_t;
 
-typedef word_count_t *word_count_list_t;
-#endif /* PINTOS_LIST */
+typedef struct word_count_list {
+    word_count_t *head;
+    struct word_arena *arena;
+    size_t bytes;
+} word_count_list_t;
+#endif /* HASH_TABLE, PINTOS_LIST */
 
 /* Initialize a word count list. */
 void init_words(word_count_list_t *wclist);
 
+/*
+ * Initialize a word count list whose entries and words are allocated from an
+ * arena owned by the list, so they can all be released by free_words at
+ * once. Words passed to add_word and add_word_with_count are copied into the
+ * arena and freed.
+ */
+void init_words_with_arena(word_count_list_t *wclist);
+
+/* Free all entries and words of a word count list, leaving it empty. */
+void free_words(word_count_list_t *wclist);
+
+/*
+ * Free everything held by a word count list, including its arena, locks and
+ * hash slots. The list must be initialized again before any other use.
+ */
+void destroy_words(word_count_list_t *wclist);
+
 /* Get length of a word count list. */
 size_t len_words(word_count_list_t *wclist);
 
+/*
+ * Get the approximate number of bytes held by the entries and words of a word
+ * count list, without walking it. Hash table slots, which free_words keeps
+ * for reuse, are not included.
+ */
+size_t mem_words(word_count_list_t *wclist);
+
+/* Bytes held by a malloc'd entry and its word, as counted by mem_words. */
+static inline size_t entry_bytes(const word_count_t *wc) {
+    return sizeof(word_count_t) + strlen(wc->word) + 1;
+}
+
 /* Find a word in a word_count list. */
 word_count_t *find_word(word_count_list_t *wclist, char *word);
 
@@ -88,6 +209,82 @@ word_count_t *add_word(word_count_list_t *wclist, char *word);
 word_count_t *add_word_with_count(word_count_list_t *wclist, char *word,
                                   int count);
 
+/*
+ * Insert a copy of word with count, if not already present; increment count
+ * if present. Does not take ownership of word, so callers can pass a reused
+ * buffer and only pay for an allocation the first time a word is seen.
+ */
+word_count_t *add_word_copy(word_count_list_t *wclist, const char *word,
+                            int count);
+
+/*
+ * Hashing of words by the hash table backends. A key of several words joined
+ * by single spaces, such as an n-gram, hashes to a combination of the hashes
+ * of its words. A caller that builds keys a word at a time can then hash
+ * each word once and combine the hashes itself for add_word_copy_hashed.
+ */
+
+/* FNV-1a hash of a single word of len bytes. */
+static inline uint64_t hash_word_bytes(const char *word, size_t len) {
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char) word[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+/*
+ * Returns the hash of a key extended by one more word, given the key's hash
+ * (0 for the empty key) and the word's hash_word_bytes.
+ */
+static inline uint64_t hash_key_extend(uint64_t key_hash, uint64_t word_hash) {
+    return (key_hash ^ word_hash) * 1099511628211ULL;
+}
+
+/* Hash of a NUL-terminated key of one or more space-separated words. */
+static inline uint64_t hash_key(const char *key) {
+    uint64_t h = 0;
+    const char *word = key;
+    for (const char *p = key;; p++) {
+        if (*p == ' ' || *p == '\0') {
+            h = hash_key_extend(h, hash_word_bytes(word, p - word));
+            if (*p == '\0') {
+                return h;
+            }
+            word = p + 1;
+        }
+    }
+}
+
+/*
+ * Like add_word_copy, for a key whose hash_key has already been computed.
+ * Backends that do not hash ignore it.
+ */
+word_count_t *add_word_copy_hashed(word_count_list_t *wclist,
+                                   const char *word, uint64_t hash, int count);
+
+#ifdef PTHREADS
+/*
+ * Move every entry of src into wclist, adding counts of words present in
+ * both. src is left empty. Safe to call concurrently on the same wclist.
+ */
+void merge_words(word_count_list_t *wclist, word_count_list_t *src);
+#endif /* PTHREADS */
+
+#if defined(HASH_TABLE) && defined(PTHREADS)
+/*
+ * Initialize a word count list split into nshards locked shards, each with
+ * its own arena if use_arena is set.
+ */
+void init_words_sharded(word_count_list_t *wclist, size_t nshards,
+                        bool use_arena);
+#endif /* HASH_TABLE && PTHREADS */
+
+/* Call fn on every entry of a word count list, in list order. */
+void wordcount_foreach(word_count_list_t *wclist,
+                       void fn(word_count_t *wc, void *aux), void *aux);
+
 /* Print word counts to a file. */
 void fprint_words(word_count_list_t *wclist, FILE *outfile);
 
@@ -95,4 +292,14 @@ void fprint_words(word_count_list_t *wclist, FILE *outfile);
 void wordcount_sort(word_count_list_t *wclist,
                     bool less(const word_count_t *, const word_count_t *));
 
+/*
+ * Sort a word count list like wordcount_sort, splitting the work across up to
+ * nthreads threads. Must not run concurrently with other operations on the
+ * list.
+ */
+void wordcount_sort_parallel(word_count_list_t *wclist,
+                             bool less(const word_count_t *,
+                                       const word_count_t *),
+                             int nthreads);
+
 #endif /* WORD_COUNT_H */
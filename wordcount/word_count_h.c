@@ -0,0 +1,235 @@
+/*
+ * Implementation of the word_count interface using an open-addressing hash
+ * table.
+ */
+
+/*
+ * Copyright (C) 2019 University of California, Berkeley
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef HASH_TABLE
+#error "HASH_TABLE must be #define'd when compiling word_count_h.c"
+#endif
+
+#include "word_count.h"
+#include "word_sort.h"
+
+/* Initial number of slots; must be a power of two. */
+#define INITIAL_CAPACITY 1024
+
+/*
+ * Returns the slot holding word, or the empty slot where it would be
+ * inserted. Linear probing; capacity is always a power of two.
+ */
+static word_count_t **probe(word_count_list_t *wclist, const char *word,
+                            uint64_t hash) {
+    size_t mask = wclist->capacity - 1;
+    size_t i = hash & mask;
+    word_count_t **slot;
+    while (*(slot = &wclist->slots[i]) != NULL) {
+        if ((*slot)->hash == hash && strcmp((*slot)->word, word) == 0) {
+            break;
+        }
+        i = (i + 1) & mask;
+    }
+    return slot;
+}
+
+/* Doubles the table and reinserts every entry. Returns false on failure. */
+static bool grow(word_count_list_t *wclist) {
+    size_t capacity = wclist->capacity * 2;
+    word_count_t **slots = calloc(capacity, sizeof(word_count_t *));
+    if (slots == NULL) {
+        perror("calloc");
+        return false;
+    }
+    free(wclist->slots);
+    wclist->slots = slots;
+    wclist->capacity = capacity;
+
+    size_t mask = capacity - 1;
+    for (word_count_t *wc = wclist->head; wc != NULL; wc = wc->next) {
+        size_t i = wc->hash & mask;
+        while (slots[i] != NULL) {
+            i = (i + 1) & mask;
+        }
+        slots[i] = wc;
+    }
+    return true;
+}
+
+void init_words(word_count_list_t *wclist) {
+    wclist->slots = calloc(INITIAL_CAPACITY, sizeof(word_count_t *));
+    if (wclist->slots == NULL) {
+        perror("calloc");
+    }
+    wclist->capacity = wclist->slots != NULL ? INITIAL_CAPACITY : 0;
+    wclist->size = 0;
+    wclist->head = NULL;
+    wclist->arena = NULL;
+    wclist->bytes = 0;
+}
+
+void init_words_with_arena(word_count_list_t *wclist) {
+    init_words(wclist);
+    wclist->arena = arena_create();
+}
+
+void free_words(word_count_list_t *wclist) {
+    if (wclist->arena != NULL) {
+        arena_reset(wclist->arena);
+    } else {
+        word_count_t *wc = wclist->head;
+        while (wc != NULL) {
+            word_count_t *next = wc->next;
+            free(wc->word);
+            free(wc);
+            wc = next;
+        }
+    }
+    memset(wclist->slots, 0, wclist->capacity * sizeof(word_count_t *));
+    wclist->size = 0;
+    wclist->head = NULL;
+    wclist->bytes = 0;
+}
+
+void destroy_words(word_count_list_t *wclist) {
+    free_words(wclist);
+    free(wclist->slots);
+    arena_destroy(wclist->arena);
+    wclist->slots = NULL;
+    wclist->capacity = 0;
+    wclist->arena = NULL;
+}
+
+size_t len_words(word_count_list_t *wclist) {
+    return wclist->size;
+}
+
+size_t mem_words(word_count_list_t *wclist) {
+    return wclist->arena != NULL ? wclist->arena->used : wclist->bytes;
+}
+
+word_count_t *find_word(word_count_list_t *wclist, char *word) {
+    if (wclist->capacity == 0) {
+        return NULL;
+    }
+    return *probe(wclist, word, hash_key(word));
+}
+
+/*
+ * Adds count to word, whose hash_key is hash, creating an entry for it if it
+ * is absent. Returns NULL if out of memory.
+ */
+static word_count_t *add(word_count_list_t *wclist, const char *word,
+                         uint64_t hash, int count, bool copy) {
+    if (wclist->capacity == 0) {
+        return NULL;
+    }
+
+    word_count_t *wc = *probe(wclist, word, hash);
+    if (wc != NULL) {
+        wc->count += count;
+        return wc;
+    }
+
+    /* Keep the load factor at or below 3/4. */
+    if ((wclist->size + 1) * 4 > wclist->capacity * 3 && !grow(wclist)) {
+        return NULL;
+    }
+    if ((wc = arena_new_entry(wclist->arena, sizeof(word_count_t), word,
+                              copy)) == NULL) {
+        return NULL;
+    }
+    wc->count = count;
+    wc->hash = hash;
+    wc->next = wclist->head;
+    wclist->head = wc;
+    wclist->size++;
+    wclist->bytes += entry_bytes(wc);
+    *probe(wclist, wc->word, hash) = wc;
+    return wc;
+}
+
+word_count_t *add_word_with_count(word_count_list_t *wclist, char *word,
+                                  int count) {
+    return add(wclist, word, hash_key(word), count, false);
+}
+
+word_count_t *add_word_copy(word_count_list_t *wclist, const char *word,
+                            int count) {
+    return add(wclist, word, hash_key(word), count, true);
+}
+
+word_count_t *add_word_copy_hashed(word_count_list_t *wclist,
+                                   const char *word, uint64_t hash,
+                                   int count) {
+    return add(wclist, word, hash, count, true);
+}
+
+word_count_t *add_word(word_count_list_t *wclist, char *word) {
+    return add(wclist, word, hash_key(word), 1, false);
+}
+
+void wordcount_foreach(word_count_list_t *wclist,
+                       void fn(word_count_t *wc, void *aux), void *aux) {
+    word_count_t *wc;
+    for (wc = wclist->head; wc != NULL; wc = wc->next) {
+        fn(wc, aux);
+    }
+}
+
+void fprint_words(word_count_list_t *wclist, FILE *outfile) {
+    word_count_t *wc;
+    for (wc = wclist->head; wc != NULL; wc = wc->next) {
+        fprintf(outfile, "%8d\t%s\n", wc->count, wc->word);
+    }
+}
+
+/*
+ * Sorts the entries on up to nthreads threads and relinks them in order, or
+ * sorts the list in place if the entries cannot be gathered into an array.
+ */
+static void sort_table(word_count_list_t *wclist,
+                       bool less(const word_count_t *, const word_count_t *),
+                       int nthreads) {
+    word_count_t **entries = sort_words(wclist, less, nthreads);
+    if (entries == NULL) {
+        wclist->head = sort_chain(wclist->head, wclist->size,
+                                  offsetof(word_count_t, next), less);
+        return;
+    }
+
+    /* Relink in sorted order; the hash slots are unaffected. */
+    size_t n = wclist->size;
+    for (size_t i = 0; i + 1 < n; i++) {
+        entries[i]->next = entries[i + 1];
+    }
+    entries[n - 1]->next = NULL;
+    wclist->head = entries[0];
+    free(entries);
+}
+
+void wordcount_sort(word_count_list_t *wclist,
+                    bool less(const word_count_t *, const word_count_t *)) {
+    sort_table(wclist, less, 1);
+}
+
+void wordcount_sort_parallel(word_count_list_t *wclist,
+                             bool less(const word_count_t *,
+                                       const word_count_t *),
+                             int nthreads) {
+    sort_table(wclist, less, nthreads);
+}
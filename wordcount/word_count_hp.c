@@ -0,0 +1,431 @@
+/*
+ * Implementation of the word_count interface using a sharded hash table with
+ * one pthread mutex per shard.
+ */
+
+/*
+ * Copyright (C) 2019 University of California, Berkeley
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef HASH_TABLE
+#error "HASH_TABLE must be #define'd when compiling word_count_hp.c"
+#endif
+
+#ifndef PTHREADS
+#error "PTHREADS must be #define'd when compiling word_count_hp.c"
+#endif
+
+#include "word_count.h"
+#include "word_sort.h"
+#include "word_stats.h"
+
+/* Number of shards used by init_words. */
+#define DEFAULT_SHARDS 64
+
+/* Initial number of slots per shard; must be a power of two. */
+#define SHARD_CAPACITY 256
+
+/*
+ * Shards are picked with the high bits of the hash and slots with the low
+ * bits, so the two choices stay independent.
+ */
+static word_count_shard_t *shard_of(word_count_list_t *wclist, uint64_t hash) {
+    return &wclist->shards[(hash >> 32) % wclist->nshards];
+}
+
+/*
+ * Returns the slot holding word, or the empty slot where it would be
+ * inserted. Caller must hold the shard lock.
+ */
+static word_count_t **probe(word_count_shard_t *shard, const char *word,
+                            uint64_t hash) {
+    size_t mask = shard->capacity - 1;
+    size_t i = hash & mask;
+    word_count_t **slot;
+    while (*(slot = &shard->slots[i]) != NULL) {
+        if ((*slot)->hash == hash && strcmp((*slot)->word, word) == 0) {
+            break;
+        }
+        i = (i + 1) & mask;
+    }
+    return slot;
+}
+
+/*
+ * Makes room for one more entry, doubling the shard if that would push the
+ * load factor above 3/4. Caller must hold the shard lock.
+ */
+static bool reserve(word_count_shard_t *shard) {
+    if ((shard->size + 1) * 4 <= shard->capacity * 3) {
+        return true;
+    }
+
+    size_t capacity = shard->capacity * 2;
+    word_count_t **slots = calloc(capacity, sizeof(word_count_t *));
+    if (slots == NULL) {
+        perror("calloc");
+        return false;
+    }
+
+    size_t mask = capacity - 1;
+    for (size_t j = 0; j < shard->capacity; j++) {
+        word_count_t *wc = shard->slots[j];
+        if (wc != NULL) {
+            size_t i = wc->hash & mask;
+            while (slots[i] != NULL) {
+                i = (i + 1) & mask;
+            }
+            slots[i] = wc;
+        }
+    }
+    free(shard->slots);
+    shard->slots = slots;
+    shard->capacity = capacity;
+    return true;
+}
+
+void init_words_sharded(word_count_list_t *wclist, size_t nshards,
+                        bool use_arena) {
+    wclist->head = NULL;
+    wclist->nshards = 0;
+    if (nshards == 0) {
+        nshards = 1;
+    }
+    if ((wclist->shards = calloc(nshards, sizeof(word_count_shard_t))) ==
+        NULL) {
+        perror("calloc");
+        return;
+    }
+    wclist->nshards = nshards;
+
+    for (size_t i = 0; i < nshards; i++) {
+        word_count_shard_t *shard = &wclist->shards[i];
+        shard->slots = calloc(SHARD_CAPACITY, sizeof(word_count_t *));
+        if (shard->slots == NULL) {
+            perror("calloc");
+            wclist->nshards = i;
+            return;
+        }
+        shard->capacity = SHARD_CAPACITY;
+        shard->size = 0;
+        shard->bytes = 0;
+        pthread_mutex_init(&shard->lock, NULL);
+        /* Each shard owns an arena so allocation happens under its lock. */
+        shard->arena = use_arena ? arena_create() : NULL;
+    }
+}
+
+void init_words(word_count_list_t *wclist) {
+    init_words_sharded(wclist, DEFAULT_SHARDS, false);
+}
+
+void init_words_with_arena(word_count_list_t *wclist) {
+    init_words_sharded(wclist, DEFAULT_SHARDS, true);
+}
+
+/* Frees every entry of a shard. Caller must hold the shard lock. */
+static void shard_clear(word_count_shard_t *shard) {
+    if (shard->arena != NULL) {
+        arena_reset(shard->arena);
+    } else {
+        for (size_t j = 0; j < shard->capacity; j++) {
+            word_count_t *wc = shard->slots[j];
+            if (wc != NULL) {
+                free(wc->word);
+                free(wc);
+            }
+        }
+    }
+    memset(shard->slots, 0, shard->capacity * sizeof(word_count_t *));
+    shard->size = 0;
+    shard->bytes = 0;
+}
+
+void free_words(word_count_list_t *wclist) {
+    for (size_t i = 0; i < wclist->nshards; i++) {
+        pthread_mutex_lock(&wclist->shards[i].lock);
+        shard_clear(&wclist->shards[i]);
+        pthread_mutex_unlock(&wclist->shards[i].lock);
+    }
+    wclist->head = NULL;
+}
+
+void destroy_words(word_count_list_t *wclist) {
+    for (size_t i = 0; i < wclist->nshards; i++) {
+        word_count_shard_t *shard = &wclist->shards[i];
+        shard_clear(shard);
+        free(shard->slots);
+        arena_destroy(shard->arena);
+        pthread_mutex_destroy(&shard->lock);
+    }
+    free(wclist->shards);
+    wclist->shards = NULL;
+    wclist->nshards = 0;
+    wclist->head = NULL;
+}
+
+size_t len_words(word_count_list_t *wclist) {
+    size_t len = 0;
+    for (size_t i = 0; i < wclist->nshards; i++) {
+        len += wclist->shards[i].size;
+    }
+    return len;
+}
+
+size_t mem_words(word_count_list_t *wclist) {
+    size_t bytes = 0;
+    for (size_t i = 0; i < wclist->nshards; i++) {
+        word_count_shard_t *shard = &wclist->shards[i];
+        bytes += shard->arena != NULL ? shard->arena->used : shard->bytes;
+    }
+    return bytes;
+}
+
+word_count_t *find_word(word_count_list_t *wclist, char *word) {
+    if (wclist->nshards == 0) {
+        return NULL;
+    }
+    uint64_t hash = hash_key(word);
+    word_count_shard_t *shard = shard_of(wclist, hash);
+    pthread_mutex_lock(&shard->lock);
+    word_count_t *wc = *probe(shard, word, hash);
+    pthread_mutex_unlock(&shard->lock);
+    return wc;
+}
+
+/*
+ * Adds count to word in shard, creating an entry for it if it is absent.
+ * Caller must hold the shard lock. Returns NULL if out of memory.
+ */
+static word_count_t *shard_add(word_count_shard_t *shard, const char *word,
+                               uint64_t hash, int count, bool copy) {
+    word_count_t *wc = *probe(shard, word, hash);
+    if (wc != NULL) {
+        wc->count += count;
+        return wc;
+    }
+    if (!reserve(shard) ||
+        (wc = arena_new_entry(shard->arena, sizeof(word_count_t), word,
+                              copy)) == NULL) {
+        return NULL;
+    }
+    wc->count = count;
+    wc->hash = hash;
+    wc->next = NULL;
+    *probe(shard, wc->word, hash) = wc;
+    shard->size++;
+    shard->bytes += entry_bytes(wc);
+    return wc;
+}
+
+static word_count_t *add(word_count_list_t *wclist, const char *word,
+                         uint64_t hash, int count, bool copy) {
+    if (wclist->nshards == 0) {
+        return NULL;
+    }
+
+    word_count_shard_t *shard = shard_of(wclist, hash);
+    pthread_mutex_lock(&shard->lock);
+    size_t size = shard->size;
+    word_count_t *wc = shard_add(shard, word, hash, count, copy);
+    if (shard->size != size) {
+        wclist->head = NULL;
+    }
+    pthread_mutex_unlock(&shard->lock);
+    return wc;
+}
+
+word_count_t *add_word_with_count(word_count_list_t *wclist, char *word,
+                                  int count) {
+    return add(wclist, word, hash_key(word), count, false);
+}
+
+word_count_t *add_word_copy(word_count_list_t *wclist, const char *word,
+                            int count) {
+    return add(wclist, word, hash_key(word), count, true);
+}
+
+word_count_t *add_word_copy_hashed(word_count_list_t *wclist,
+                                   const char *word, uint64_t hash,
+                                   int count) {
+    return add(wclist, word, hash, count, true);
+}
+
+word_count_t *add_word(word_count_list_t *wclist, char *word) {
+    return add(wclist, word, hash_key(word), 1, false);
+}
+
+/*
+ * Moves wc into shard, or folds its count into an existing entry and, if it
+ * was malloc'd, frees it. wc must come from the same kind of allocator as
+ * the entries of shard. Caller must hold the shard lock.
+ */
+static void shard_move_entry(word_count_shard_t *shard, word_count_t *wc) {
+    word_count_t **slot = probe(shard, wc->word, wc->hash);
+    if (*slot != NULL) {
+        (*slot)->count += wc->count;
+    } else if (reserve(shard)) {
+        *probe(shard, wc->word, wc->hash) = wc;
+        shard->size++;
+        shard->bytes += entry_bytes(wc);
+        return;
+    }
+    if (shard->arena == NULL) {
+        free(wc->word);
+        free(wc);
+    }
+}
+
+void merge_words(word_count_list_t *wclist, word_count_list_t *src) {
+    for (size_t i = 0; i < src->nshards; i++) {
+        word_count_shard_t *from = &src->shards[i];
+        word_count_shard_t *to = NULL;
+
+        /*
+         * With matching shard counts every entry of a source shard lands in
+         * the same destination shard, so it is locked once for the batch.
+         */
+        STATS_START(wait_start);
+        if (src->nshards == wclist->nshards) {
+            to = &wclist->shards[i];
+            pthread_mutex_lock(&to->lock);
+        }
+        pthread_mutex_lock(&from->lock);
+        STATS_ADD_TIME(merge_wait_ns, wait_start);
+        STATS_START(hold_start);
+        STATS_ADD(merge_entries, from->size);
+
+        /*
+         * Entries change hands between shards with the same kind of
+         * allocator. An arena shard takes over the source's blocks along
+         * with its entries.
+         */
+        if (to != NULL && (to->arena == NULL) == (from->arena == NULL)) {
+            for (size_t j = 0; j < from->capacity; j++) {
+                if (from->slots[j] != NULL) {
+                    shard_move_entry(to, from->slots[j]);
+                    from->slots[j] = NULL;
+                }
+            }
+            from->size = 0;
+            from->bytes = 0;
+            if (from->arena != NULL) {
+                arena_adopt(to->arena, from->arena);
+            }
+        } else {
+            for (size_t j = 0; j < from->capacity; j++) {
+                word_count_t *wc = from->slots[j];
+                if (wc == NULL) {
+                    continue;
+                }
+                if (to != NULL) {
+                    shard_add(to, wc->word, wc->hash, wc->count, true);
+                } else {
+                    add(wclist, wc->word, wc->hash, wc->count, true);
+                }
+            }
+            shard_clear(from);
+        }
+
+        STATS_ADD_TIME(merge_hold_ns, hold_start);
+        pthread_mutex_unlock(&from->lock);
+        if (to != NULL) {
+            pthread_mutex_unlock(&to->lock);
+        }
+    }
+    src->head = NULL;
+    wclist->head = NULL;
+}
+
+void wordcount_foreach(word_count_list_t *wclist,
+                       void fn(word_count_t *wc, void *aux), void *aux) {
+    if (wclist->head != NULL) {
+        for (word_count_t *wc = wclist->head; wc != NULL; wc = wc->next) {
+            fn(wc, aux);
+        }
+        return;
+    }
+    for (size_t i = 0; i < wclist->nshards; i++) {
+        word_count_shard_t *shard = &wclist->shards[i];
+        for (size_t j = 0; j < shard->capacity; j++) {
+            if (shard->slots[j] != NULL) {
+                fn(shard->slots[j], aux);
+            }
+        }
+    }
+}
+
+void fprint_words(word_count_list_t *wclist, FILE *outfile) {
+    if (wclist->head != NULL) {
+        for (word_count_t *wc = wclist->head; wc != NULL; wc = wc->next) {
+            fprintf(outfile, "%8d\t%s\n", wc->count, wc->word);
+        }
+        return;
+    }
+    for (size_t i = 0; i < wclist->nshards; i++) {
+        word_count_shard_t *shard = &wclist->shards[i];
+        for (size_t j = 0; j < shard->capacity; j++) {
+            word_count_t *wc = shard->slots[j];
+            if (wc != NULL) {
+                fprintf(outfile, "%8d\t%s\n", wc->count, wc->word);
+            }
+        }
+    }
+}
+
+/*
+ * Sorts the entries of every shard on up to nthreads threads and links them
+ * in order from head, which fprint_words then follows. If the entries cannot
+ * be gathered into an array, they are chained from head and sorted in place.
+ */
+static void sort_shards(word_count_list_t *wclist,
+                        bool less(const word_count_t *, const word_count_t *),
+                        int nthreads) {
+    size_t n = len_words(wclist);
+    word_count_t **entries = sort_words(wclist, less, nthreads);
+    if (entries == NULL) {
+        word_count_t *head = NULL;
+        for (size_t i = 0; i < wclist->nshards; i++) {
+            word_count_shard_t *shard = &wclist->shards[i];
+            for (size_t j = 0; j < shard->capacity; j++) {
+                if (shard->slots[j] != NULL) {
+                    shard->slots[j]->next = head;
+                    head = shard->slots[j];
+                }
+            }
+        }
+        wclist->head = sort_chain(head, n, offsetof(word_count_t, next), less);
+        return;
+    }
+
+    for (size_t k = 0; k + 1 < n; k++) {
+        entries[k]->next = entries[k + 1];
+    }
+    entries[n - 1]->next = NULL;
+    wclist->head = entries[0];
+    free(entries);
+}
+
+void wordcount_sort(word_count_list_t *wclist,
+                    bool less(const word_count_t *, const word_count_t *)) {
+    sort_shards(wclist, less, 1);
+}
+
+void wordcount_sort_parallel(word_count_list_t *wclist,
+                             bool less(const word_count_t *,
+                                       const word_count_t *),
+                             int nthreads) {
+    sort_shards(wclist, less, nthreads);
+}
@@ -25,18 +25,122 @@
 #endif
 
 #include "word_count.h"
+#include "word_sort.h"
+
+#ifdef HOT_CACHE
+/* Slot that entries found in the list are promoted to. */
+#define HOT_INSERT (HOT_ENTRIES / 2)
+
+/*
+ * Looks word up in the hot array. A hit moves one slot towards the front, so
+ * the most frequent words gather there.
+ */
+static word_count_t *hot_find(word_count_list_t *wclist, const char *word,
+                              uint32_t hash, uint32_t len) {
+    struct word_count_hot *hot = wclist->hot;
+    for (size_t i = 0; i < wclist->nhot; i++) {
+        if (hot[i].hash == hash && hot[i].len == len &&
+            strcmp(hot[i].wc->word, word) == 0) {
+            if (i > 0) {
+                struct word_count_hot tmp = hot[i];
+                hot[i] = hot[i - 1];
+                hot[i - 1] = tmp;
+                return hot[i - 1].wc;
+            }
+            return hot[i].wc;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Adds an entry missing from the hot array. Once the array is full, it is
+ * placed in the middle, dropping the last entry, so that a word used once
+ * does not push out the established ones at the front.
+ */
+static void hot_insert(word_count_list_t *wclist, word_count_t *wc,
+                       uint32_t hash, uint32_t len) {
+    size_t i = wclist->nhot;
+    if (i < HOT_ENTRIES) {
+        wclist->nhot++;
+    } else {
+        i = HOT_INSERT;
+        memmove(&wclist->hot[i + 1], &wclist->hot[i],
+                (HOT_ENTRIES - i - 1) * sizeof(struct word_count_hot));
+    }
+    wclist->hot[i].hash = hash;
+    wclist->hot[i].len = len;
+    wclist->hot[i].wc = wc;
+}
+
+/*
+ * Moves an entry whose count grew ahead of the entries with lower counts, so
+ * the list stays ordered by count and frequent words are found early.
+ */
+static void promote(word_count_list_t *wclist, word_count_t *wc) {
+    struct list_elem *pos = &wc->elem;
+    while (list_prev(pos) != list_head(&wclist->lst) &&
+           list_entry(list_prev(pos), word_count_t, elem)->count < wc->count) {
+        pos = list_prev(pos);
+    }
+    if (pos != &wc->elem) {
+        list_remove(&wc->elem);
+        list_insert(pos, &wc->elem);
+    }
+}
+#endif /* HOT_CACHE */
 
 void init_words(word_count_list_t *wclist) {
-    list_init(wclist); 
+    list_init(&wclist->lst);
+    wclist->arena = NULL;
+    wclist->bytes = 0;
+#ifdef HOT_CACHE
+    wclist->nhot = 0;
+#endif
+}
+
+void init_words_with_arena(word_count_list_t *wclist) {
+    init_words(wclist);
+    wclist->arena = arena_create();
+}
+
+void free_words(word_count_list_t *wclist) {
+    if (wclist->arena != NULL) {
+        arena_reset(wclist->arena);
+        list_init(&wclist->lst);
+    }
+    while (!list_empty(&wclist->lst)) {
+        struct list_elem *e = list_pop_front(&wclist->lst);
+        word_count_t *element = list_entry(e, word_count_t, elem);
+        free(element->word);
+        free(element);
+    }
+    wclist->bytes = 0;
+#ifdef HOT_CACHE
+    wclist->nhot = 0;
+#endif
+}
+
+void destroy_words(word_count_list_t *wclist) {
+    free_words(wclist);
+    arena_destroy(wclist->arena);
+    wclist->arena = NULL;
 }
 
 size_t len_words(word_count_list_t *wclist) {
-    return list_size(&(*wclist));
+    return list_size(&wclist->lst);
 }
 
-word_count_t *find_word(word_count_list_t *wclist, char *word) {
-    struct list_elem *wc = list_begin(wclist);
-    for (wc = list_begin(wclist); wc != list_end(wclist); wc = list_next(wc)){
+size_t mem_words(word_count_list_t *wclist) {
+    return wclist->arena != NULL ? wclist->arena->used : wclist->bytes;
+}
+
+/* Walks the list for word. */
+static word_count_t *find_in_list(word_count_list_t *wclist,
+                                  const char *word) {
+    struct list_elem *wc;
+    for (wc = list_begin(&wclist->lst); wc != list_end(&wclist->lst);
+         wc = list_next(wc)) {
         word_count_t *element = list_entry(wc, word_count_t, elem);
         if (strcmp(word, element->word) == 0){
             return element;
@@ -46,45 +150,81 @@ word_count_t *find_word(word_count_list_t *wclist, char *word) {
     return NULL;
 }
 
-word_count_t *add_word_with_count(word_count_list_t *wclist, char *word,
-                                  int count) {
-    word_count_t *wcExisting = find_word(wclist, word);
+word_count_t *find_word(word_count_list_t *wclist, char *word) {
+#ifdef HOT_CACHE
+    uint32_t len = strlen(word);
+    uint32_t hash = (uint32_t) hash_word_bytes(word, len);
+    word_count_t *wc = hot_find(wclist, word, hash, len);
+    if (wc == NULL && (wc = find_in_list(wclist, word)) != NULL) {
+        hot_insert(wclist, wc, hash, len);
+    }
+    return wc;
+#else
+    return find_in_list(wclist, word);
+#endif
+}
+
+static word_count_t *add(word_count_list_t *wclist, const char *word,
+                         int count, bool copy) {
+    word_count_t *wcExisting = find_word(wclist, (char *) word);
     if (wcExisting != NULL){
         wcExisting->count = wcExisting->count + count;
+#ifdef HOT_CACHE
+        promote(wclist, wcExisting);
+#endif
         return wcExisting;
-       
-    } else {
-        word_count_t *newWC = malloc(sizeof(word_count_t));
-        if (newWC == NULL){
-            return NULL; //in case malloc doesnt work
-        }
+    }
 
-        newWC->count = count;
-        newWC->word = word; //strdup(word), if having issues
-        list_push_back(wclist, &newWC->elem);
-        return newWC;
-    } 
+    word_count_t *newWC =
+        arena_new_entry(wclist->arena, sizeof(word_count_t), word, copy);
+    if (newWC == NULL){
+        return NULL;
+    }
+    newWC->count = count;
+    list_push_back(&wclist->lst, &newWC->elem);
+    wclist->bytes += entry_bytes(newWC);
+#ifdef HOT_CACHE
+    uint32_t len = strlen(newWC->word);
+    uint32_t hash = (uint32_t) hash_word_bytes(newWC->word, len);
+    hot_insert(wclist, newWC, hash, len);
+    promote(wclist, newWC);
+#endif
+    return newWC;
+}
 
-    
+word_count_t *add_word_with_count(word_count_list_t *wclist, char *word,
+                                  int count) {
+    return add(wclist, word, count, false);
 }
 
 word_count_t *add_word(word_count_list_t *wclist, char *word) {
-    /*
- * Insert word with count=1, if not already present; increment count if
- * present. Takes ownership of word.
- */
-    word_count_t *wc = find_word(wclist, word);
-    if (wc != NULL){
-        wc->count = wc->count + 1;
-        return wc;
-    } else {
-        return add_word_with_count(wclist, word, 1);
+    return add(wclist, word, 1, false);
+}
+
+word_count_t *add_word_copy(word_count_list_t *wclist, const char *word,
+                            int count) {
+    return add(wclist, word, count, true);
+}
+
+word_count_t *add_word_copy_hashed(word_count_list_t *wclist,
+                                   const char *word, uint64_t hash,
+                                   int count) {
+    return add(wclist, word, count, true);
+}
+
+void wordcount_foreach(word_count_list_t *wclist,
+                       void fn(word_count_t *wc, void *aux), void *aux) {
+    struct list_elem *e;
+    for (e = list_begin(&wclist->lst); e != list_end(&wclist->lst);
+         e = list_next(e)) {
+        fn(list_entry(e, word_count_t, elem), aux);
     }
 }
 
 void fprint_words(word_count_list_t *wclist, FILE *outfile) {
-    struct list_elem *wc = list_begin(wclist);
-    for (wc = list_begin(wclist); wc != list_end(wclist); wc = list_next(wc)) {
+    struct list_elem *wc;
+    for (wc = list_begin(&wclist->lst); wc != list_end(&wclist->lst);
+         wc = list_next(wc)) {
         word_count_t *element = list_entry(wc, word_count_t, elem);
         fprintf(outfile, "%8d\t%s\n", element->count, element->word);
     }
@@ -105,7 +245,25 @@ static bool less_list(const struct list_elem *ewc1,
 
 void wordcount_sort(word_count_list_t *wclist, bool less(const word_count_t *, const word_count_t *)) {
     //sorting by word or count??    
-    list_sort(wclist, less_list, less);
+    list_sort(&wclist->lst, less_list, less);
 
 }
 
+void wordcount_sort_parallel(word_count_list_t *wclist,
+                             bool less(const word_count_t *,
+                                       const word_count_t *),
+                             int nthreads) {
+    word_count_t **entries = sort_words(wclist, less, nthreads);
+    if (entries == NULL) {
+        wordcount_sort(wclist, less);
+        return;
+    }
+
+    /* Relink the elements in sorted order; no entry moves in memory. */
+    size_t n = len_words(wclist);
+    list_init(&wclist->lst);
+    for (size_t i = 0; i < n; i++) {
+        list_push_back(&wclist->lst, &entries[i]->elem);
+    }
+    free(entries);
+}
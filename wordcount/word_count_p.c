@@ -29,22 +29,54 @@
 #endif
 
 #include "word_count.h"
+#include "word_sort.h"
+#include "word_stats.h"
 
 void init_words(word_count_list_t *wclist) {
-    
-    list_init(&wclist->lst); 
-    //pthread_mutex_t localLock = PTHREAD_MUTEX_INITIALIZER;
-    //&wclist->lock = localLock;
+    list_init(&wclist->lst);
+    pthread_mutex_init(&wclist->lock, NULL);
+    wclist->arena = NULL;
+    wclist->bytes = 0;
+}
 
+void init_words_with_arena(word_count_list_t *wclist) {
+    init_words(wclist);
+    wclist->arena = arena_create();
+}
+
+void free_words(word_count_list_t *wclist) {
+    if (wclist->arena != NULL) {
+        arena_reset(wclist->arena);
+        list_init(&wclist->lst);
+    }
+    while (!list_empty(&wclist->lst)) {
+        struct list_elem *e = list_pop_front(&wclist->lst);
+        word_count_t *element = list_entry(e, word_count_t, elem);
+        free(element->word);
+        free(element);
+    }
+    wclist->bytes = 0;
+}
+
+void destroy_words(word_count_list_t *wclist) {
+    free_words(wclist);
+    arena_destroy(wclist->arena);
+    pthread_mutex_destroy(&wclist->lock);
+    wclist->arena = NULL;
 }
 
 size_t len_words(word_count_list_t *wclist) {
     return list_size(&wclist->lst);
 }
 
+size_t mem_words(word_count_list_t *wclist) {
+    return wclist->arena != NULL ? wclist->arena->used : wclist->bytes;
+}
+
 word_count_t *find_word(word_count_list_t *wclist, char *word) {
-    struct list_elem *wc = list_begin(&wclist->lst);
-    for (wc = list_begin(&wclist->lst); wc != list_end(&wclist->lst); wc = list_next(wc)){
+    struct list_elem *wc;
+    for (wc = list_begin(&wclist->lst); wc != list_end(&wclist->lst);
+         wc = list_next(wc)) {
         word_count_t *element = list_entry(wc, word_count_t, elem);
         if (strcmp(word, element->word) == 0){
             return element;
@@ -54,21 +86,96 @@ word_count_t *find_word(word_count_list_t *wclist, char *word) {
     return NULL;
 }
 
-word_count_t *add_word(word_count_list_t *wclist, char *word) {
-    word_count_t *wc = find_word(wclist, word);
+static word_count_t *add(word_count_list_t *wclist, const char *word,
+                         int count, bool copy) {
+    word_count_t *wc = find_word(wclist, (char *) word);
     if (wc != NULL){
-        wc->count = wc->count + 1;
+        wc->count = wc->count + count;
         return wc;
-    } else {
-        word_count_t *newWC = malloc(sizeof(word_count_t));
-        if (newWC == NULL){
-            return NULL; //in case malloc doesnt work
+    }
+
+    word_count_t *newWC =
+        arena_new_entry(wclist->arena, sizeof(word_count_t), word, copy);
+    if (newWC == NULL){
+        return NULL;
+    }
+    newWC->count = count;
+    list_push_back(&wclist->lst, &newWC->elem);
+    wclist->bytes += entry_bytes(newWC);
+    return newWC;
+}
+
+word_count_t *add_word(word_count_list_t *wclist, char *word) {
+    return add(wclist, word, 1, false);
+}
+
+word_count_t *add_word_with_count(word_count_list_t *wclist, char *word,
+                                  int count) {
+    return add(wclist, word, count, false);
+}
+
+word_count_t *add_word_copy(word_count_list_t *wclist, const char *word,
+                            int count) {
+    return add(wclist, word, count, true);
+}
+
+word_count_t *add_word_copy_hashed(word_count_list_t *wclist,
+                                   const char *word, uint64_t hash,
+                                   int count) {
+    return add(wclist, word, count, true);
+}
+
+void merge_words(word_count_list_t *wclist, word_count_list_t *src) {
+    STATS_START(wait_start);
+    pthread_mutex_lock(&wclist->lock);
+    STATS_ADD_TIME(merge_wait_ns, wait_start);
+    STATS_START(hold_start);
+    if ((src->arena == NULL) != (wclist->arena == NULL)) {
+        /* Entries cannot move between allocators, so copy them. */
+        struct list_elem *e;
+        for (e = list_begin(&src->lst); e != list_end(&src->lst);
+             e = list_next(e)) {
+            word_count_t *element = list_entry(e, word_count_t, elem);
+            add(wclist, element->word, element->count, true);
+            STATS_ADD(merge_entries, 1);
+        }
+        STATS_ADD_TIME(merge_hold_ns, hold_start);
+        pthread_mutex_unlock(&wclist->lock);
+        free_words(src);
+        return;
+    }
+
+    while (!list_empty(&src->lst)) {
+        struct list_elem *e = list_pop_front(&src->lst);
+        word_count_t *element = list_entry(e, word_count_t, elem);
+        word_count_t *existing = find_word(wclist, element->word);
+        if (existing == NULL) {
+            list_push_back(&wclist->lst, &element->elem);
+            wclist->bytes += entry_bytes(element);
+        } else {
+            existing->count += element->count;
+            if (src->arena == NULL) {
+                free(element->word);
+                free(element);
+            }
         }
+        STATS_ADD(merge_entries, 1);
+    }
+    src->bytes = 0;
+    if (src->arena != NULL) {
+        /* Moved entries live on in src's blocks, now owned by wclist. */
+        arena_adopt(wclist->arena, src->arena);
+    }
+    STATS_ADD_TIME(merge_hold_ns, hold_start);
+    pthread_mutex_unlock(&wclist->lock);
+}
 
-        newWC->count = 1;
-        newWC->word = word; //strdup(word), if having issues
-        list_push_back(&wclist->lst, &newWC->elem);
-        return newWC;
+void wordcount_foreach(word_count_list_t *wclist,
+                       void fn(word_count_t *wc, void *aux), void *aux) {
+    struct list_elem *e;
+    for (e = list_begin(&wclist->lst); e != list_end(&wclist->lst);
+         e = list_next(e)) {
+        fn(list_entry(e, word_count_t, elem), aux);
     }
 }
 
@@ -104,3 +211,21 @@ void wordcount_sort(word_count_list_t *wclist,
     list_sort(&wclist->lst, less_list, less);
 }
 
+void wordcount_sort_parallel(word_count_list_t *wclist,
+                             bool less(const word_count_t *,
+                                       const word_count_t *),
+                             int nthreads) {
+    word_count_t **entries = sort_words(wclist, less, nthreads);
+    if (entries == NULL) {
+        wordcount_sort(wclist, less);
+        return;
+    }
+
+    /* Relink the elements in sorted order; no entry moves in memory. */
+    size_t n = len_words(wclist);
+    list_init(&wclist->lst);
+    for (size_t i = 0; i < n; i++) {
+        list_push_back(&wclist->lst, &entries[i]->elem);
+    }
+    free(entries);
+}
@@ -25,68 +25,442 @@
 #include "word_helpers.h"
 
 #include <ctype.h>
+#include <limits.h>
+#include <locale.h>
 #include <stdio.h>
+#include <wchar.h>
+#include <wctype.h>
 
 #include "word_count.h"
+#include "word_scan.h"
+#include "word_stats.h"
+
+/* Size of the blocks read from a stream by count_words. */
+#define READ_BUFFER_SIZE (64 * 1024)
 
 /*
- * Reads a word from a stream, skipping initial non-alpha characters, and
- * stores it in a malloc'd buffer. Returns length of the word, or 0 if reached
- * end of file.
+ * Reusable buffer holding the lowercased word being looked up, so a word is
+ * only copied to the heap the first time it is inserted.
+ *
+ * When counting n-grams, buf[start, end) instead holds a sliding window of
+ * the last words scanned, joined by spaces, and each new word is lowercased
+ * straight onto its end. The window is the n-gram key, so no key is ever
+ * assembled word by word. words and hashes hold the offset and
+ * hash_word_bytes of each word in the window, oldest first, so the key's
+ * hash is combined from them without rereading the key.
  */
-static size_t get_word(char **word, FILE *infile) {
-    int ch;
-    size_t buffer_cap = 16;
-    size_t index = 0;
-    char *buffer;
+struct word_scratch {
+    char *buf;
+    size_t cap;
+    size_t start;
+    size_t end;
+    size_t words[NGRAM_MAX];
+    uint64_t hashes[NGRAM_MAX];
+    int nwords;
+};
 
-    /* Skip initial non-alpha characters. */
-    while (!isalpha(ch = fgetc(infile))) {
-        if (ch == EOF) {
-            return 0;
-        }
+#define SCRATCH_INIT {NULL, 0, 0, 0, {0}, {0}, 0}
+
+/* Set by use_utf8_words. */
+static bool utf8_words = false;
+
+/* Set by use_ngrams. */
+static int ngram_words = 1;
+
+#ifdef WORDS_STATS
+__thread struct word_stats *thread_stats;
+#endif
+
+bool use_utf8_words(void) {
+    if (setlocale(LC_CTYPE, "C.UTF-8") == NULL &&
+        setlocale(LC_CTYPE, "C.utf8") == NULL) {
+        fprintf(stderr, "no UTF-8 locale is available\n");
+        return false;
     }
+    utf8_words = true;
+    return true;
+}
 
-    /* Allocate buffer on heap. */
-    if ((buffer = malloc(buffer_cap * sizeof(char))) == NULL) {
-        perror("malloc");
+bool use_ngrams(int n) {
+    if (n < 1 || n > NGRAM_MAX) {
+        fprintf(stderr, "n-grams must have 1 to %d words\n", NGRAM_MAX);
+        return false;
+    }
+    ngram_words = n;
+    return true;
+}
+
+bool is_word_byte(unsigned char c) {
+    return isalpha(c) || (utf8_words && c >= 0x80);
+}
+
+/* Makes room for a word of len bytes and its terminator. */
+static bool reserve_scratch(struct word_scratch *scratch, size_t len) {
+    if (len < scratch->cap) {
+        return true;
+    }
+    size_t cap = scratch->cap ? scratch->cap : 64;
+    while (cap <= len) {
+        cap *= 2;
+    }
+    char *grown = realloc(scratch->buf, cap);
+    if (grown == NULL) {
+        perror("realloc");
+        return false;
+    }
+    scratch->buf = grown;
+    scratch->cap = cap;
+    return true;
+}
+
+/*
+ * Returns the offset in scratch->buf at which the next word should be
+ * written, leaving room for the space that joins it to the window.
+ */
+static size_t word_offset(struct word_scratch *scratch) {
+    if (ngram_words == 1 || scratch->nwords == 0) {
         return 0;
     }
+    if (scratch->start >= scratch->end - scratch->start) {
+        /* More of the buffer is dropped words than window; move it down. */
+        size_t shift = scratch->start;
+        memmove(scratch->buf, scratch->buf + shift, scratch->end - shift);
+        for (int i = 0; i < scratch->nwords; i++) {
+            scratch->words[i] -= shift;
+        }
+        scratch->start = 0;
+        scratch->end -= shift;
+    }
+    return scratch->end + 1;
+}
 
-    /* Accumulate word's characters into buffer. */
-    do {
-        buffer[index++] = tolower(ch);
+/*
+ * Adds the word of wlen bytes written at offset off (from word_offset) to
+ * wclist, or the n-gram it completes. Returns false if the list ran out of
+ * memory.
+ */
+static bool add_scanned(word_count_list_t *wclist,
+                        struct word_scratch *scratch, size_t off,
+                        size_t wlen) {
+    STATS_ADD(words, 1);
+    scratch->buf[off + wlen] = '\0';
+    uint64_t hash = hash_word_bytes(scratch->buf + off, wlen);
+    if (ngram_words == 1) {
+        return add_word_copy_hashed(wclist, scratch->buf,
+                                    hash_key_extend(0, hash), 1) != NULL;
+    }
 
-        /* Expand buffer if full. */
-        if (index == buffer_cap) {
-            char *new_buffer;
-            buffer_cap *= 2;
-            if ((new_buffer = realloc(buffer, buffer_cap)) == NULL) {
-                perror("realloc");
-                free(buffer);
-                return 0;
+    if (scratch->nwords == ngram_words) {
+        /* Slide the window past its oldest word. */
+        memmove(scratch->words, scratch->words + 1,
+                (ngram_words - 1) * sizeof(size_t));
+        memmove(scratch->hashes, scratch->hashes + 1,
+                (ngram_words - 1) * sizeof(uint64_t));
+        scratch->nwords--;
+        scratch->start = scratch->words[0];
+    } else if (scratch->nwords == 0) {
+        scratch->start = off;
+    }
+    if (scratch->nwords > 0) {
+        scratch->buf[off - 1] = ' ';
+    }
+    scratch->words[scratch->nwords] = off;
+    scratch->hashes[scratch->nwords++] = hash;
+    scratch->end = off + wlen;
+    if (scratch->nwords < ngram_words) {
+        return true;
+    }
+
+    uint64_t key_hash = 0;
+    for (int i = 0; i < ngram_words; i++) {
+        key_hash = hash_key_extend(key_hash, scratch->hashes[i]);
+    }
+    return add_word_copy_hashed(wclist, scratch->buf + scratch->start,
+                                key_hash, 1) != NULL;
+}
+
+/*
+ * Scans buf[0, len) for runs of alpha characters and adds each run of two or
+ * more characters to wclist. Returns false if the list ran out of memory.
+ */
+static bool scan_words(word_count_list_t *wclist, const char *buf, size_t len,
+                       struct word_scratch *scratch) {
+    const char *p = buf;
+    const char *end = buf + len;
+    while (p < end) {
+        const char *start = skip_nonalpha(p, end);
+        p = skip_alpha(start, end);
+        size_t wlen = p - start;
+        if (wlen < 2) {
+            continue;
+        }
+
+        size_t off = word_offset(scratch);
+        if (!reserve_scratch(scratch, off + wlen)) {
+            return false;
+        }
+        lower_alpha(scratch->buf + off, start, wlen);
+        if (!add_scanned(wclist, scratch, off, wlen)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Decodes the UTF-8 character at p. Returns its length and stores it in *wc,
+ * or returns 1 and stores WEOF for a byte that does not start a valid
+ * character.
+ */
+static size_t decode_utf8(const char *p, const char *end, wint_t *wc) {
+    mbstate_t state;
+    wchar_t c;
+    memset(&state, 0, sizeof(state));
+    size_t n = mbrtowc(&c, p, end - p, &state);
+    if (n == 0 || n == (size_t) -1 || n == (size_t) -2) {
+        *wc = WEOF;
+        return 1;
+    }
+    *wc = c;
+    return n;
+}
+
+/*
+ * Like scan_words, but for UTF-8 text: words are runs of Unicode letters,
+ * folded to lowercase, of two or more characters. Runs of ASCII letters are
+ * still found and lowercased with the word_scan kernels; only non-ASCII
+ * characters are decoded.
+ */
+static bool scan_words_utf8(word_count_list_t *wclist, const char *buf,
+                            size_t len, struct word_scratch *scratch) {
+    const char *p = buf;
+    const char *end = buf + len;
+    while (p < end) {
+        p = skip_ascii_nonalpha(p, end);
+        size_t off = word_offset(scratch);
+        size_t wlen = 0;
+        size_t nchars = 0;
+        while (p < end) {
+            const char *q = skip_alpha(p, end);
+            if (q > p) {
+                if (!reserve_scratch(scratch, off + wlen + (q - p))) {
+                    return false;
+                }
+                lower_alpha(scratch->buf + off + wlen, p, q - p);
+                wlen += q - p;
+                nchars += q - p;
+                p = q;
+            }
+            if (p == end || (unsigned char) *p < 0x80) {
+                break;
             }
-            buffer = new_buffer;
+
+            wint_t wc;
+            size_t n = decode_utf8(p, end, &wc);
+            if (wc == WEOF || !iswalpha(wc)) {
+                if (wlen == 0) {
+                    /* Not a word after all; keep looking. */
+                    p += n;
+                    p = skip_ascii_nonalpha(p, end);
+                    continue;
+                }
+                break;
+            }
+            if (!reserve_scratch(scratch, off + wlen + MB_LEN_MAX)) {
+                return false;
+            }
+            mbstate_t state;
+            memset(&state, 0, sizeof(state));
+            size_t m =
+                wcrtomb(scratch->buf + off + wlen, towlower(wc), &state);
+            if (m == (size_t) -1) {
+                memcpy(scratch->buf + off + wlen, p, n);
+                m = n;
+            }
+            wlen += m;
+            nchars++;
+            p += n;
+        }
+        if (nchars < 2) {
+            continue;
         }
-    } while (isalpha(ch = fgetc(infile)));
-    buffer[index] = '\0';
+        if (!add_scanned(wclist, scratch, off, wlen)) {
+            return false;
+        }
+    }
+    return true;
+}
 
-    *word = buffer;
-    return index;
+/* Scans a block with the tokenizer selected by use_utf8_words. */
+static bool scan_block(word_count_list_t *wclist, const char *buf, size_t len,
+                       struct word_scratch *scratch) {
+    STATS_ADD(bytes, len);
+    if (utf8_words) {
+        return scan_words_utf8(wclist, buf, len, scratch);
+    }
+    return scan_words(wclist, buf, len, scratch);
 }
 
 void count_words(word_count_list_t *wclist, FILE *infile) {
+    count_words_blocks(wclist, infile, NULL, NULL);
+}
+
+void count_words_blocks(word_count_list_t *wclist, FILE *infile,
+                        bool block_done(word_count_list_t *wclist, void *aux),
+                        void *aux) {
     /* Extract all words in infile and update word counts for them. */
-    char *word;
-    size_t len;
-    while ((len = get_word(&word, infile)) != 0) {
-        if (len == 1) {
-            free(word);
-        } else if (add_word(wclist, word) == NULL) {
-            free(word);
+    struct word_scratch scratch = SCRATCH_INIT;
+    size_t cap = READ_BUFFER_SIZE;
+    size_t have = 0;
+    char *buf = malloc(cap);
+    if (buf == NULL) {
+        perror("malloc");
+        return;
+    }
+
+    for (;;) {
+        size_t n = fread(buf + have, 1, cap - have, infile);
+        have += n;
+        if (n == 0) {
+            /* End of stream: whatever is left is complete. */
+            scan_block(wclist, buf, have, &scratch);
+            break;
+        }
+
+        /*
+         * Scan up to the last non-alpha character and carry the trailing,
+         * possibly incomplete, word over to the next block.
+         */
+        size_t keep = have;
+        while (keep > 0 && is_word_byte(buf[keep - 1])) {
+            keep--;
+        }
+        if (keep == 0 && have == cap) {
+            /* A single word fills the buffer; make room for the rest. */
+            char *grown = realloc(buf, cap * 2);
+            if (grown == NULL) {
+                perror("realloc");
+                break;
+            }
+            buf = grown;
+            cap *= 2;
+            continue;
+        }
+        if (!scan_block(wclist, buf, keep, &scratch)) {
+            break;
+        }
+        if (block_done != NULL && !block_done(wclist, aux)) {
+            break;
+        }
+        memmove(buf, buf + keep, have - keep);
+        have -= keep;
+    }
+
+    free(scratch.buf);
+    free(buf);
+}
+
+void count_words_buffer(word_count_list_t *wclist, const char *buf,
+                        size_t len) {
+    struct word_scratch scratch = SCRATCH_INIT;
+    scan_block(wclist, buf, len, &scratch);
+    free(scratch.buf);
+}
+
+size_t word_boundary(const char *buf, size_t len, size_t pos) {
+    while (pos > 0 && pos < len && is_word_byte(buf[pos - 1]) &&
+           is_word_byte(buf[pos])) {
+        pos++;
+    }
+    return pos < len ? pos : len;
+}
+
+static void heap_sift_down(struct top_heap *heap, size_t i) {
+    for (;;) {
+        size_t min = i;
+        size_t left = 2 * i + 1;
+        size_t right = left + 1;
+        if (left < heap->size &&
+            less_count(heap->entries[left], heap->entries[min])) {
+            min = left;
+        }
+        if (right < heap->size &&
+            less_count(heap->entries[right], heap->entries[min])) {
+            min = right;
+        }
+        if (min == i) {
             return;
         }
+        word_count_t *tmp = heap->entries[i];
+        heap->entries[i] = heap->entries[min];
+        heap->entries[min] = tmp;
+        i = min;
+    }
+}
+
+bool top_heap_init(struct top_heap *heap, size_t k) {
+    heap->size = 0;
+    heap->k = k;
+    heap->entries = NULL;
+    if (k > 0 && (heap->entries = malloc(k * sizeof(word_count_t *))) == NULL) {
+        perror("malloc");
+        return false;
+    }
+    return true;
+}
+
+bool top_heap_admits(const struct top_heap *heap, const word_count_t *wc) {
+    return heap->size < heap->k ||
+           (heap->size > 0 && less_count(heap->entries[0], wc));
+}
+
+word_count_t *top_heap_offer(struct top_heap *heap, word_count_t *wc) {
+    if (heap->size < heap->k) {
+        /* Sift the new entry up. */
+        size_t i = heap->size++;
+        while (i > 0 && less_count(wc, heap->entries[(i - 1) / 2])) {
+            heap->entries[i] = heap->entries[(i - 1) / 2];
+            i = (i - 1) / 2;
+        }
+        heap->entries[i] = wc;
+        return NULL;
+    }
+    if (!top_heap_admits(heap, wc)) {
+        return wc;
+    }
+    word_count_t *out = heap->entries[0];
+    heap->entries[0] = wc;
+    heap_sift_down(heap, 0);
+    return out;
+}
+
+void fprint_top_heap(struct top_heap *heap, FILE *outfile, bool free_entries) {
+    /* Popping the minimum repeatedly yields ascending order. */
+    while (heap->size > 0) {
+        word_count_t *wc = heap->entries[0];
+        fprintf(outfile, "%8d\t%s\n", wc->count, wc->word);
+        heap->entries[0] = heap->entries[--heap->size];
+        heap_sift_down(heap, 0);
+        if (free_entries) {
+            free(wc);
+        }
+    }
+    free(heap->entries);
+    heap->entries = NULL;
+}
+
+static void heap_offer(word_count_t *wc, void *aux) {
+    top_heap_offer(aux, wc);
+}
+
+void fprint_top_words(word_count_list_t *wclist, FILE *outfile, size_t k) {
+    size_t n = len_words(wclist);
+    struct top_heap heap;
+    if (!top_heap_init(&heap, k < n ? k : n)) {
+        return;
     }
+    wordcount_foreach(wclist, heap_offer, &heap);
+    fprint_top_heap(&heap, outfile, false);
 }
 
 bool less_count(const word_count_t *wc1, const word_count_t *wc2) {
@@ -30,12 +30,101 @@
 
 #include "word_count.h"
 
+/*
+ * Switches every function below from ASCII words to UTF-8 words: runs of
+ * Unicode letters, folded to lowercase with towlower. Sets the LC_CTYPE
+ * locale to C.UTF-8, so must be called before any threads are started.
+ * Returns false if that locale is not available.
+ */
+bool use_utf8_words(void);
+
+/* Most words counted together by use_ngrams. */
+#define NGRAM_MAX 8
+
+/*
+ * Switches every function below from counting words to counting n-grams:
+ * runs of n consecutive words, joined by single spaces into one key, e.g.
+ * "of the" for n = 2. Words are found as before, and n-grams run across
+ * punctuation and lines but not across calls, so input cut into pieces
+ * loses the n-grams spanning each cut. Must be called before any threads
+ * are started. Returns false if n is not between 1 and NGRAM_MAX.
+ */
+bool use_ngrams(int n);
+
+/*
+ * Returns true if c may be part of a word, so text must not be split right
+ * after it without possibly cutting a word in two.
+ */
+bool is_word_byte(unsigned char c);
+
 /*
  * Reads all words from a stream and updates a word count list with their
- * counts.
+ * counts. The stream is read in large blocks that are scanned with the same
+ * tokenizer as count_words_buffer.
  */
 void count_words(word_count_list_t *wclist, FILE *infile);
 
+/*
+ * Like count_words, but calls block_done(wclist, aux) after the words of each
+ * block have been added, e.g. to flush the list once it grows too large.
+ * Stops reading if block_done returns false.
+ */
+void count_words_blocks(word_count_list_t *wclist, FILE *infile,
+                        bool block_done(word_count_list_t *wclist, void *aux),
+                        void *aux);
+
+/*
+ * Counts all words in buf[0, len) into a word count list, scanning the
+ * buffer in place. Words are only copied when first inserted. The range is
+ * treated as a complete stream, so it should start and end on word
+ * boundaries (see word_boundary).
+ */
+void count_words_buffer(word_count_list_t *wclist, const char *buf,
+                        size_t len);
+
+/*
+ * Returns the first offset at or after pos that does not split a word in
+ * buf[0, len), i.e. a safe place to start a chunk of the buffer.
+ */
+size_t word_boundary(const char *buf, size_t len, size_t pos);
+
+/*
+ * Prints the k entries with the highest counts, in the same order and format
+ * as sorting with less_count and calling fprint_words would. Uses a bounded
+ * heap instead of sorting the whole list.
+ */
+void fprint_top_words(word_count_list_t *wclist, FILE *outfile, size_t k);
+
+/*
+ * Min-heap, by less_count, of the k highest-count entries offered so far.
+ * fprint_top_words fills one from a list; callers that produce counts one at
+ * a time, such as a spill_merge emit function, can fill one directly and
+ * keep only k entries in memory.
+ */
+struct top_heap {
+    word_count_t **entries;
+    size_t size;
+    size_t k;
+};
+
+/* Initializes an empty heap for k entries. Returns false if out of memory. */
+bool top_heap_init(struct top_heap *heap, size_t k);
+
+/* Returns true if offering wc to the heap would keep it. */
+bool top_heap_admits(const struct top_heap *heap, const word_count_t *wc);
+
+/*
+ * Offers wc to the heap. Returns the entry left out, which is either wc or
+ * the one it replaced, or NULL if the heap was not yet full.
+ */
+word_count_t *top_heap_offer(struct top_heap *heap, word_count_t *wc);
+
+/*
+ * Prints the entries of the heap like fprint_top_words, emptying it and
+ * freeing its array. Each entry is also freed if free_entries is set.
+ */
+void fprint_top_heap(struct top_heap *heap, FILE *outfile, bool free_entries);
+
 /*
  * Returns true if the first entry has a lower count than the second entry,
  * breaking ties according to alphabetical order.
@@ -0,0 +1,224 @@
+/*
+ * Implementation of the word_io interface.
+ */
+
+/*
+ * Copyright (C) 2019 University of California, Berkeley
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "word_io.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "word_count.h"
+#include "word_helpers.h"
+
+/* Longest encoding of a 64-bit varint. */
+#define VARINT_MAX 10
+
+/* Size of the blocks read by merge_counts_binary. */
+#define READ_BUFFER_SIZE (64 * 1024)
+
+/* Encodes value into buf, which must hold VARINT_MAX bytes. */
+static size_t put_varint(unsigned char *buf, uint64_t value) {
+    size_t n = 0;
+    while (value >= 0x80) {
+        buf[n++] = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    buf[n++] = value;
+    return n;
+}
+
+/*
+ * Decodes a varint from buf[0, len) into *value. Returns the number of bytes
+ * used, or 0 if the varint is incomplete or too long.
+ */
+static size_t get_varint(const unsigned char *buf, size_t len,
+                         uint64_t *value) {
+    uint64_t v = 0;
+    for (size_t i = 0; i < len && i < VARINT_MAX; i++) {
+        v |= (uint64_t) (buf[i] & 0x7F) << (7 * i);
+        if ((buf[i] & 0x80) == 0) {
+            *value = v;
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Reads a varint from a stream into *value. Returns 1 on success, 0 if the
+ * stream ended before the first byte, and -1 otherwise.
+ */
+static int read_varint(FILE *infile, uint64_t *value) {
+    uint64_t v = 0;
+    for (int i = 0; i < VARINT_MAX; i++) {
+        int c = getc(infile);
+        if (c == EOF) {
+            return i == 0 && !ferror(infile) ? 0 : -1;
+        }
+        v |= (uint64_t) (c & 0x7F) << (7 * i);
+        if ((c & 0x80) == 0) {
+            *value = v;
+            return 1;
+        }
+    }
+    return -1;
+}
+
+int write_count_record(FILE *outfile, const char *word, size_t len,
+                       uint64_t count) {
+    unsigned char header[2 * VARINT_MAX];
+    size_t n = put_varint(header, count);
+    n += put_varint(header + n, len);
+    if (fwrite(header, 1, n, outfile) != n ||
+        fwrite(word, 1, len, outfile) != len) {
+        return -1;
+    }
+    return 0;
+}
+
+int read_count_record(FILE *infile, char **word, size_t *cap,
+                      uint64_t *count) {
+    uint64_t len;
+    int status = read_varint(infile, count);
+    if (status <= 0) {
+        return status;
+    }
+    if (read_varint(infile, &len) <= 0) {
+        return -1;
+    }
+    if (len >= *cap) {
+        size_t grown_cap = *cap ? *cap : 64;
+        while (grown_cap <= len) {
+            grown_cap *= 2;
+        }
+        char *grown = realloc(*word, grown_cap);
+        if (grown == NULL) {
+            perror("realloc");
+            return -1;
+        }
+        *word = grown;
+        *cap = grown_cap;
+    }
+    if (fread(*word, 1, len, infile) != len) {
+        return -1;
+    }
+    (*word)[len] = '\0';
+    return 1;
+}
+
+struct write_state {
+    FILE *outfile;
+    bool failed;
+};
+
+static void write_entry(word_count_t *wc, void *aux) {
+    struct write_state *state = aux;
+    if (write_count_record(state->outfile, wc->word, strlen(wc->word),
+                           (unsigned) wc->count) != 0) {
+        state->failed = true;
+    }
+}
+
+int write_counts_binary(word_count_list_t *wclist, FILE *outfile,
+                        bool sorted) {
+    if (sorted) {
+        wordcount_sort(wclist, less_word);
+    }
+    struct write_state state = {outfile, false};
+    wordcount_foreach(wclist, write_entry, &state);
+    if (state.failed || fflush(outfile) == EOF) {
+        perror("could not write counts");
+        return -1;
+    }
+    return 0;
+}
+
+size_t merge_counts_buffer(word_count_list_t *wclist, const char *buf,
+                           size_t len) {
+    const unsigned char *p = (const unsigned char *) buf;
+    size_t pos = 0;
+    char small[256];
+
+    for (;;) {
+        uint64_t count, wlen;
+        size_t n = get_varint(p + pos, len - pos, &count);
+        if (n == 0) {
+            break;
+        }
+        size_t m = get_varint(p + pos + n, len - pos - n, &wlen);
+        if (m == 0 || wlen > len - pos - n - m) {
+            break;
+        }
+
+        /* add_word_copy needs a terminated word. */
+        char *word = wlen < sizeof(small) ? small : malloc(wlen + 1);
+        if (word == NULL) {
+            perror("malloc");
+            break;
+        }
+        memcpy(word, p + pos + n + m, wlen);
+        word[wlen] = '\0';
+        add_word_copy(wclist, word, count);
+        if (word != small) {
+            free(word);
+        }
+        pos += n + m + wlen;
+    }
+    return pos;
+}
+
+int merge_counts_binary(word_count_list_t *wclist, FILE *infile) {
+    size_t cap = READ_BUFFER_SIZE;
+    size_t have = 0;
+    char *buf = malloc(cap);
+    if (buf == NULL) {
+        perror("malloc");
+        return -1;
+    }
+
+    size_t n;
+    while ((n = fread(buf + have, 1, cap - have, infile)) > 0) {
+        have += n;
+        size_t used = merge_counts_buffer(wclist, buf, have);
+        memmove(buf, buf + used, have - used);
+        have -= used;
+        if (have == cap) {
+            /* A single record is larger than the buffer. */
+            char *grown = realloc(buf, cap * 2);
+            if (grown == NULL) {
+                perror("realloc");
+                free(buf);
+                return -1;
+            }
+            buf = grown;
+            cap *= 2;
+        }
+    }
+    free(buf);
+
+    if (ferror(infile)) {
+        perror("could not read counts");
+        return -1;
+    } else if (have != 0) {
+        fprintf(stderr, "read ill-formed counts (%zu trailing bytes)\n", have);
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,72 @@
+/*
+ * The word_io interface serializes word count lists in a compact binary
+ * format, so that counts can be passed between processes or stored on disk
+ * without formatting and parsing text.
+ *
+ * A stream is a sequence of records, each holding the count as a varint
+ * (7 bits per byte, low bits first), the word length as a varint, and the
+ * word's bytes without a terminator. The stream ends at end of file.
+ */
+
+/*
+ * Copyright (C) 2019 University of California, Berkeley
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef WORD_IO_H
+#define WORD_IO_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "word_count.h"
+
+/*
+ * Writes every entry of a word count list to a stream. If sorted is set,
+ * the list is first sorted alphabetically, so the records come out in word
+ * order. Returns 0 on success, -1 on a write error.
+ */
+int write_counts_binary(word_count_list_t *wclist, FILE *outfile,
+                        bool sorted);
+
+/*
+ * Reads a stream written by write_counts_binary and adds its counts to a
+ * word count list. Returns 0 on success, -1 on a read error or ill-formed
+ * stream.
+ */
+int merge_counts_binary(word_count_list_t *wclist, FILE *infile);
+
+/*
+ * Adds the counts of every complete record in buf[0, len) to a word count
+ * list. Returns the number of bytes consumed; any incomplete record at the
+ * end is left for the caller to complete and pass in again.
+ */
+size_t merge_counts_buffer(word_count_list_t *wclist, const char *buf,
+                           size_t len);
+
+/* Writes one record. Returns 0 on success, -1 on a write error. */
+int write_count_record(FILE *outfile, const char *word, size_t len,
+                       uint64_t count);
+
+/*
+ * Reads the next record of a stream into *count and *word, a NUL-terminated
+ * malloc'd buffer of *cap bytes that is grown as needed and may start out
+ * NULL. Returns 1 if a record was read, 0 at the end of the stream, and -1 on
+ * a read error or ill-formed stream.
+ */
+int read_count_record(FILE *infile, char **word, size_t *cap,
+                      uint64_t *count);
+
+#endif /* WORD_IO_H */
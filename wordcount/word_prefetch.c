@@ -0,0 +1,246 @@
+/*
+ * Implementation of the word_prefetch interface.
+ */
+
+/*
+ * Copyright (C) 2019 University of California, Berkeley
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* For fopencookie. */
+#define _GNU_SOURCE
+
+#include "word_prefetch.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Number and size of the buffers the reader thread fills in turn. */
+#define PREFETCH_BUFFERS 2
+#define PREFETCH_BUFFER_SIZE (1024 * 1024)
+
+struct prefetch_buffer {
+    char *data;
+    size_t len;
+    bool full; /* Filled by the reader and not yet consumed. */
+};
+
+/*
+ * State shared by the reader thread and the stream. The reader fills
+ * bufs[0], bufs[1], ... in order and the stream consumes them in the same
+ * order, each side waiting on cond for the other to hand a buffer over.
+ */
+struct word_prefetch {
+    int fd;
+    pthread_t reader;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    struct prefetch_buffer bufs[PREFETCH_BUFFERS];
+    bool eof;  /* The reader filled its last buffer and exited. */
+    int error; /* errno of the read that ended the input, if any. */
+    bool stop; /* Set by fclose to make the reader exit. */
+
+    /* Only used by the stream. */
+    size_t take; /* Buffer being consumed. */
+    size_t pos;  /* Offset of the next byte to consume in it. */
+};
+
+static void *reader_main(void *arg) {
+    struct word_prefetch *pf = arg;
+    /* Pipes have no offsets and gain nothing from hints. */
+    off_t offset = lseek(pf->fd, 0, SEEK_CUR);
+    if (offset != -1) {
+        posix_fadvise(pf->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+
+    for (size_t fill = 0;; fill = (fill + 1) % PREFETCH_BUFFERS) {
+        struct prefetch_buffer *buf = &pf->bufs[fill];
+        pthread_mutex_lock(&pf->lock);
+        while (buf->full && !pf->stop) {
+            pthread_cond_wait(&pf->cond, &pf->lock);
+        }
+        bool stop = pf->stop;
+        pthread_mutex_unlock(&pf->lock);
+        if (stop) {
+            return NULL;
+        }
+
+        /* Have the kernel start on the buffers after this one. */
+        if (offset != -1) {
+            posix_fadvise(pf->fd, offset + PREFETCH_BUFFER_SIZE,
+                          (off_t) PREFETCH_BUFFER_SIZE * PREFETCH_BUFFERS,
+                          POSIX_FADV_WILLNEED);
+        }
+
+        size_t len = 0;
+        int error = 0;
+        while (len < PREFETCH_BUFFER_SIZE) {
+            ssize_t n =
+                read(pf->fd, buf->data + len, PREFETCH_BUFFER_SIZE - len);
+            if (n > 0) {
+                len += n;
+            } else if (n == 0) {
+                break;
+            } else if (errno != EINTR) {
+                error = errno;
+                break;
+            }
+        }
+        if (offset != -1) {
+            offset += len;
+        }
+
+        /* A short buffer is the last one. */
+        bool last = len < PREFETCH_BUFFER_SIZE;
+        pthread_mutex_lock(&pf->lock);
+        buf->len = len;
+        buf->full = true;
+        pf->eof = last;
+        pf->error = error;
+        pthread_cond_broadcast(&pf->cond);
+        pthread_mutex_unlock(&pf->lock);
+        if (last) {
+            return NULL;
+        }
+    }
+}
+
+static ssize_t prefetch_read(void *cookie, char *out, size_t size) {
+    struct word_prefetch *pf = cookie;
+    size_t done = 0;
+    while (done < size) {
+        struct prefetch_buffer *buf = &pf->bufs[pf->take];
+        pthread_mutex_lock(&pf->lock);
+        while (!buf->full && !pf->eof) {
+            pthread_cond_wait(&pf->cond, &pf->lock);
+        }
+        bool full = buf->full;
+        int error = pf->error;
+        pthread_mutex_unlock(&pf->lock);
+        if (!full) {
+            /* Everything the reader read has been consumed. */
+            if (done == 0 && error != 0) {
+                errno = error;
+                return -1;
+            }
+            break;
+        }
+
+        size_t n = buf->len - pf->pos;
+        if (n > size - done) {
+            n = size - done;
+        }
+        memcpy(out + done, buf->data + pf->pos, n);
+        pf->pos += n;
+        done += n;
+
+        if (pf->pos == buf->len) {
+            /* Hand the buffer back to the reader. */
+            pthread_mutex_lock(&pf->lock);
+            buf->full = false;
+            pthread_cond_broadcast(&pf->cond);
+            pthread_mutex_unlock(&pf->lock);
+            pf->take = (pf->take + 1) % PREFETCH_BUFFERS;
+            pf->pos = 0;
+        }
+    }
+    return done;
+}
+
+static void prefetch_free(struct word_prefetch *pf) {
+    pthread_cond_destroy(&pf->cond);
+    pthread_mutex_destroy(&pf->lock);
+    free(pf->bufs[0].data);
+    free(pf);
+}
+
+static int prefetch_close(void *cookie) {
+    struct word_prefetch *pf = cookie;
+    pthread_mutex_lock(&pf->lock);
+    pf->stop = true;
+    pthread_cond_broadcast(&pf->cond);
+    pthread_mutex_unlock(&pf->lock);
+    pthread_join(pf->reader, NULL);
+
+    int status = close(pf->fd);
+    prefetch_free(pf);
+    return status;
+}
+
+FILE *prefetch_fdopen(int fd) {
+    struct word_prefetch *pf = calloc(1, sizeof(struct word_prefetch));
+    if (pf == NULL) {
+        return NULL;
+    }
+    char *data = malloc((size_t) PREFETCH_BUFFER_SIZE * PREFETCH_BUFFERS);
+    if (data == NULL) {
+        free(pf);
+        return NULL;
+    }
+    for (size_t i = 0; i < PREFETCH_BUFFERS; i++) {
+        pf->bufs[i].data = data + i * PREFETCH_BUFFER_SIZE;
+    }
+    pf->fd = fd;
+    pthread_mutex_init(&pf->lock, NULL);
+    pthread_cond_init(&pf->cond, NULL);
+
+    int error = pthread_create(&pf->reader, NULL, reader_main, pf);
+    if (error != 0) {
+        prefetch_free(pf);
+        errno = error;
+        return NULL;
+    }
+
+    cookie_io_functions_t io = {
+        .read = prefetch_read,
+        .write = NULL,
+        .seek = NULL,
+        .close = prefetch_close,
+    };
+    FILE *stream = fopencookie(pf, "r", io);
+    if (stream == NULL) {
+        error = errno;
+        pf->fd = -1;
+        prefetch_close(pf);
+        errno = error;
+    }
+    return stream;
+}
+
+FILE *prefetch_fopen(const char *filename) {
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1) {
+        return NULL;
+    }
+    FILE *stream = prefetch_fdopen(fd);
+    if (stream == NULL) {
+        int error = errno;
+        close(fd);
+        errno = error;
+    }
+    return stream;
+}
+
+FILE *prefetch_open_input(const char *filename, bool prefetch) {
+    if (prefetch) {
+        return filename != NULL ? prefetch_fopen(filename)
+                                : prefetch_fdopen(STDIN_FILENO);
+    }
+    return filename != NULL ? fopen(filename, "r") : stdin;
+}
@@ -0,0 +1,49 @@
+/*
+ * The word_prefetch interface opens input for the word count tools through
+ * a reader thread, so the next part of a file is read while the current one
+ * is being counted and the disk and the CPU work at the same time.
+ */
+
+/*
+ * Copyright (C) 2019 University of California, Berkeley
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef WORD_PREFETCH_H
+#define WORD_PREFETCH_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+/*
+ * Opens filename for reading through a prefetching stream, which can be
+ * passed to count_words and count_words_blocks like any other. A reader
+ * thread fills one of two large buffers while the caller consumes the other,
+ * and asks the kernel with posix_fadvise to read further ahead still.
+ * fclose stops the thread. Like fopen, returns NULL and sets errno on
+ * error.
+ */
+FILE *prefetch_fopen(const char *filename);
+
+/* Like prefetch_fopen, but reads from fd, which fclose closes. */
+FILE *prefetch_fdopen(int fd);
+
+/*
+ * Opens filename, or standard input if filename is NULL, for counting:
+ * through a prefetching stream if prefetch is set, and with plain stdio
+ * otherwise. Callers close the stream unless it is stdin.
+ */
+FILE *prefetch_open_input(const char *filename, bool prefetch);
+
+#endif /* WORD_PREFETCH_H */
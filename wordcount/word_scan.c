@@ -0,0 +1,219 @@
+/*
+ * Implementation of the word_scan interface. On x86-64 the SSE2 kernels are
+ * always available and AVX2 kernels are selected at startup if the CPU
+ * supports them; other machines use the scalar loops.
+ */
+
+/*
+ * Copyright (C) 2019 University of California, Berkeley
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "word_scan.h"
+
+#include <stdbool.h>
+
+static inline bool is_letter(unsigned char c) {
+    return (unsigned char) ((c | 0x20) - 'a') < 26;
+}
+
+static const char *skip_nonalpha_scalar(const char *p, const char *end) {
+    while (p < end && !is_letter(*p)) {
+        p++;
+    }
+    return p;
+}
+
+static const char *skip_alpha_scalar(const char *p, const char *end) {
+    while (p < end && is_letter(*p)) {
+        p++;
+    }
+    return p;
+}
+
+static const char *skip_ascii_nonalpha_scalar(const char *p,
+                                              const char *end) {
+    while (p < end && !is_letter(*p) && (unsigned char) *p < 0x80) {
+        p++;
+    }
+    return p;
+}
+
+static void lower_alpha_scalar(char *dst, const char *src, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        dst[i] = src[i] | 0x20;
+    }
+}
+
+#ifdef __x86_64__
+#include <immintrin.h>
+
+/*
+ * A byte c is a letter iff (c | 0x20) is in ['a', 'z']. Biasing by
+ * -128 - 'a' maps that range to [-128, -103], which a single signed compare
+ * can test for.
+ */
+
+static inline __m128i letters_sse2(__m128i v) {
+    __m128i folded = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    __m128i biased = _mm_add_epi8(folded, _mm_set1_epi8((char) (-128 - 'a')));
+    return _mm_cmplt_epi8(biased, _mm_set1_epi8(-128 + 26));
+}
+
+static const char *skip_nonalpha_sse2(const char *p, const char *end) {
+    for (; end - p >= 16; p += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *) p);
+        unsigned mask = _mm_movemask_epi8(letters_sse2(v));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return skip_nonalpha_scalar(p, end);
+}
+
+static const char *skip_alpha_sse2(const char *p, const char *end) {
+    for (; end - p >= 16; p += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *) p);
+        unsigned mask = ~_mm_movemask_epi8(letters_sse2(v)) & 0xFFFF;
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return skip_alpha_scalar(p, end);
+}
+
+static const char *skip_ascii_nonalpha_sse2(const char *p,
+                                            const char *end) {
+    for (; end - p >= 16; p += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *) p);
+        unsigned mask = _mm_movemask_epi8(_mm_or_si128(letters_sse2(v), v));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return skip_ascii_nonalpha_scalar(p, end);
+}
+
+static void lower_alpha_sse2(char *dst, const char *src, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (src + i));
+        _mm_storeu_si128((__m128i *) (dst + i),
+                         _mm_or_si128(v, _mm_set1_epi8(0x20)));
+    }
+    lower_alpha_scalar(dst + i, src + i, n - i);
+}
+
+#define AVX2 __attribute__((target("avx2")))
+
+static inline AVX2 __m256i letters_avx2(__m256i v) {
+    __m256i folded = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+    __m256i biased =
+        _mm256_add_epi8(folded, _mm256_set1_epi8((char) (-128 - 'a')));
+    return _mm256_cmpgt_epi8(_mm256_set1_epi8(-128 + 26), biased);
+}
+
+static AVX2 const char *skip_nonalpha_avx2(const char *p, const char *end) {
+    for (; end - p >= 32; p += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) p);
+        unsigned mask = _mm256_movemask_epi8(letters_avx2(v));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return skip_nonalpha_sse2(p, end);
+}
+
+static AVX2 const char *skip_alpha_avx2(const char *p, const char *end) {
+    for (; end - p >= 32; p += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) p);
+        unsigned mask = ~_mm256_movemask_epi8(letters_avx2(v));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return skip_alpha_sse2(p, end);
+}
+
+static AVX2 const char *skip_ascii_nonalpha_avx2(const char *p,
+                                                 const char *end) {
+    for (; end - p >= 32; p += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) p);
+        unsigned mask =
+            _mm256_movemask_epi8(_mm256_or_si256(letters_avx2(v), v));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+    return skip_ascii_nonalpha_sse2(p, end);
+}
+
+static AVX2 void lower_alpha_avx2(char *dst, const char *src, size_t n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) (src + i));
+        _mm256_storeu_si256((__m256i *) (dst + i),
+                            _mm256_or_si256(v, _mm256_set1_epi8(0x20)));
+    }
+    lower_alpha_sse2(dst + i, src + i, n - i);
+}
+
+static const char *(*skip_nonalpha_impl)(const char *, const char *) =
+    skip_nonalpha_sse2;
+static const char *(*skip_alpha_impl)(const char *, const char *) =
+    skip_alpha_sse2;
+static const char *(*skip_ascii_nonalpha_impl)(const char *, const char *) =
+    skip_ascii_nonalpha_sse2;
+static void (*lower_alpha_impl)(char *, const char *, size_t) =
+    lower_alpha_sse2;
+
+/* Picks the widest kernels the CPU supports before main runs. */
+__attribute__((constructor)) static void word_scan_init(void) {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        skip_nonalpha_impl = skip_nonalpha_avx2;
+        skip_alpha_impl = skip_alpha_avx2;
+        skip_ascii_nonalpha_impl = skip_ascii_nonalpha_avx2;
+        lower_alpha_impl = lower_alpha_avx2;
+    }
+}
+
+#else /* __x86_64__ */
+
+static const char *(*skip_nonalpha_impl)(const char *, const char *) =
+    skip_nonalpha_scalar;
+static const char *(*skip_alpha_impl)(const char *, const char *) =
+    skip_alpha_scalar;
+static const char *(*skip_ascii_nonalpha_impl)(const char *, const char *) =
+    skip_ascii_nonalpha_scalar;
+static void (*lower_alpha_impl)(char *, const char *, size_t) =
+    lower_alpha_scalar;
+
+#endif /* __x86_64__ */
+
+const char *skip_nonalpha(const char *p, const char *end) {
+    return skip_nonalpha_impl(p, end);
+}
+
+const char *skip_alpha(const char *p, const char *end) {
+    return skip_alpha_impl(p, end);
+}
+
+const char *skip_ascii_nonalpha(const char *p, const char *end) {
+    return skip_ascii_nonalpha_impl(p, end);
+}
+
+void lower_alpha(char *dst, const char *src, size_t n) {
+    lower_alpha_impl(dst, src, n);
+}
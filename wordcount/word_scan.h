@@ -0,0 +1,47 @@
+/*
+ * The word_scan interface finds runs of ASCII letters in a buffer and
+ * lowercases them, processing 16 or 32 bytes at a time where the CPU allows.
+ */
+
+/*
+ * Copyright (C) 2019 University of California, Berkeley
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef WORD_SCAN_H
+#define WORD_SCAN_H
+
+#include <stddef.h>
+
+/*
+ * Letters are the ASCII characters A-Z and a-z, which matches isalpha in the
+ * "C" locale used by the word tools.
+ */
+
+/* Returns the first letter in [p, end), or end if there is none. */
+const char *skip_nonalpha(const char *p, const char *end);
+
+/* Returns the first non-letter in [p, end), or end if there is none. */
+const char *skip_alpha(const char *p, const char *end);
+
+/*
+ * Returns the first letter or non-ASCII byte in [p, end), or end if there is
+ * none, i.e. skips the ASCII bytes that cannot start a word in UTF-8 text.
+ */
+const char *skip_ascii_nonalpha(const char *p, const char *end);
+
+/* Copies n letters from src to dst, converting them to lowercase. */
+void lower_alpha(char *dst, const char *src, size_t n);
+
+#endif /* WORD_SCAN_H */
@@ -0,0 +1,277 @@
+/*
+ * Implementation of the word_snapshot interface.
+ */
+
+/*
+ * Copyright (C) 2019 University of California, Berkeley
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "word_snapshot.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "word_helpers.h"
+#include "word_io.h"
+
+/* First line of every snapshot, naming the format version. */
+#define SNAPSHOT_MAGIC "wordcount snapshot 1\n"
+
+/*
+ * Manifest lines hold the offset, size, mtime seconds and nanoseconds, the
+ * tail word or "-", and the path, which runs to the end of the line.
+ */
+#define NO_TAIL "-"
+
+static struct snapshot_file *find_file(struct word_snapshot *snap,
+                                       const char *path) {
+    for (size_t i = 0; i < snap->nfiles; i++) {
+        if (strcmp(snap->files[i].path, path) == 0) {
+            return &snap->files[i];
+        }
+    }
+    return NULL;
+}
+
+/* Appends an entry for a file that has not been read yet. */
+static struct snapshot_file *add_file(struct word_snapshot *snap,
+                                      const char *path) {
+    if (snap->nfiles == snap->cap) {
+        size_t cap = snap->cap ? snap->cap * 2 : 16;
+        struct snapshot_file *files =
+            realloc(snap->files, cap * sizeof(struct snapshot_file));
+        if (files == NULL) {
+            perror("realloc");
+            return NULL;
+        }
+        snap->files = files;
+        snap->cap = cap;
+    }
+    struct snapshot_file *file = &snap->files[snap->nfiles];
+    if ((file->path = strdup(path)) == NULL) {
+        perror("strdup");
+        return NULL;
+    }
+    file->offset = 0;
+    file->size = 0;
+    file->mtime.tv_sec = 0;
+    file->mtime.tv_nsec = 0;
+    file->tail = NULL;
+    snap->nfiles++;
+    return file;
+}
+
+int snapshot_load(struct word_snapshot *snap, word_count_list_t *wclist,
+                  const char *path) {
+    snap->files = NULL;
+    snap->nfiles = 0;
+    snap->cap = 0;
+
+    FILE *infile = fopen(path, "r");
+    if (infile == NULL) {
+        if (errno == ENOENT) {
+            return 0;
+        }
+        perror(path);
+        return -1;
+    }
+
+    char header[sizeof(SNAPSHOT_MAGIC)];
+    size_t nfiles;
+    if (fgets(header, sizeof(header), infile) == NULL ||
+        strcmp(header, SNAPSHOT_MAGIC) != 0 ||
+        fscanf(infile, "%zu\n", &nfiles) != 1) {
+        goto bad;
+    }
+    for (size_t i = 0; i < nfiles; i++) {
+        long long offset, size, sec;
+        long nsec;
+        char *tail = NULL;
+        char *name = NULL;
+        size_t cap = 0;
+        ssize_t len;
+        if (fscanf(infile, "%lld %lld %lld %ld %ms", &offset, &size, &sec,
+                   &nsec, &tail) != 5 ||
+            getc(infile) != ' ' ||
+            (len = getline(&name, &cap, infile)) <= 1) {
+            free(tail);
+            free(name);
+            goto bad;
+        }
+        name[len - 1] = '\0';
+
+        struct snapshot_file *file = add_file(snap, name);
+        free(name);
+        if (file == NULL) {
+            free(tail);
+            fclose(infile);
+            return -1;
+        }
+        file->offset = offset;
+        file->size = size;
+        file->mtime.tv_sec = sec;
+        file->mtime.tv_nsec = nsec;
+        if (strcmp(tail, NO_TAIL) == 0) {
+            free(tail);
+        } else {
+            file->tail = tail;
+        }
+    }
+
+    int status = merge_counts_binary(wclist, infile);
+    fclose(infile);
+    return status;
+
+bad:
+    fprintf(stderr, "%s: not a word count snapshot\n", path);
+    fclose(infile);
+    return -1;
+}
+
+int snapshot_count_file(struct word_snapshot *snap, word_count_list_t *wclist,
+                        const char *filename) {
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1) {
+        perror(filename);
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        perror("fstat");
+        close(fd);
+        return -1;
+    }
+
+    struct snapshot_file *file = find_file(snap, filename);
+    if (file == NULL) {
+        if ((file = add_file(snap, filename)) == NULL) {
+            close(fd);
+            return -1;
+        }
+    } else if (st.st_size < file->size) {
+        fprintf(stderr, "%s: file shrank since the snapshot, skipping\n",
+                filename);
+        close(fd);
+        return 0;
+    } else if (st.st_size == file->size &&
+               st.st_mtim.tv_sec == file->mtime.tv_sec &&
+               st.st_mtim.tv_nsec == file->mtime.tv_nsec) {
+        close(fd);
+        return 0;
+    }
+
+    size_t len = st.st_size;
+    size_t offset = file->offset;
+    size_t cut = len;
+    char *tail = NULL;
+    if (len > offset) {
+        char *buf = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (buf == MAP_FAILED) {
+            perror("mmap");
+            close(fd);
+            return -1;
+        }
+        madvise(buf, len, MADV_SEQUENTIAL);
+
+        /* Leave the trailing word for when the file has grown further. */
+        while (cut > offset && is_word_byte(buf[cut - 1])) {
+            cut--;
+        }
+        count_words_buffer(wclist, buf + offset, cut - offset);
+        if (cut < len && (tail = strndup(buf + cut, len - cut)) == NULL) {
+            perror("strndup");
+            munmap(buf, len);
+            close(fd);
+            return -1;
+        }
+        munmap(buf, len);
+    }
+    close(fd);
+
+    free(file->tail);
+    file->tail = tail;
+    file->offset = cut;
+    file->size = len;
+    file->mtime = st.st_mtim;
+    return 0;
+}
+
+int snapshot_save(struct word_snapshot *snap, word_count_list_t *wclist,
+                  const char *path) {
+    size_t len = strlen(path) + sizeof(".tmp");
+    char *tmp_path = malloc(len);
+    if (tmp_path == NULL) {
+        perror("malloc");
+        return -1;
+    }
+    snprintf(tmp_path, len, "%s.tmp", path);
+
+    FILE *outfile = fopen(tmp_path, "w");
+    if (outfile == NULL) {
+        perror(tmp_path);
+        free(tmp_path);
+        return -1;
+    }
+    fputs(SNAPSHOT_MAGIC, outfile);
+    fprintf(outfile, "%zu\n", snap->nfiles);
+    for (size_t i = 0; i < snap->nfiles; i++) {
+        struct snapshot_file *file = &snap->files[i];
+        fprintf(outfile, "%lld %lld %lld %ld %s %s\n",
+                (long long) file->offset, (long long) file->size,
+                (long long) file->mtime.tv_sec, file->mtime.tv_nsec,
+                file->tail != NULL ? file->tail : NO_TAIL, file->path);
+    }
+    if (write_counts_binary(wclist, outfile, false) != 0) {
+        fclose(outfile);
+        unlink(tmp_path);
+        free(tmp_path);
+        return -1;
+    }
+    if (fclose(outfile) == EOF || rename(tmp_path, path) == -1) {
+        perror(path);
+        unlink(tmp_path);
+        free(tmp_path);
+        return -1;
+    }
+    free(tmp_path);
+    return 0;
+}
+
+void snapshot_add_tails(struct word_snapshot *snap,
+                        word_count_list_t *wclist) {
+    for (size_t i = 0; i < snap->nfiles; i++) {
+        const char *tail = snap->files[i].tail;
+        if (tail != NULL) {
+            count_words_buffer(wclist, tail, strlen(tail));
+        }
+    }
+}
+
+void snapshot_free(struct word_snapshot *snap) {
+    for (size_t i = 0; i < snap->nfiles; i++) {
+        free(snap->files[i].path);
+        free(snap->files[i].tail);
+    }
+    free(snap->files);
+    snap->files = NULL;
+    snap->nfiles = 0;
+    snap->cap = 0;
+}
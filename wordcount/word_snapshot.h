@@ -0,0 +1,87 @@
+/*
+ * The word_snapshot interface persists word counts between runs, so that a
+ * growing set of files can be recounted by only reading what was added since
+ * the last run.
+ *
+ * A snapshot file holds a manifest of the input files followed by the counts
+ * in the word_io record format. For each file the manifest records how many
+ * bytes have been counted, and the file's size and modification time at the
+ * time. Counting stops before a file's trailing word, since more letters may
+ * be appended to it later; that word is kept in the manifest instead and
+ * added to the counts separately (see snapshot_add_tails).
+ */
+
+/*
+ * Copyright (C) 2019 University of California, Berkeley
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef WORD_SNAPSHOT_H
+#define WORD_SNAPSHOT_H
+
+#include <sys/types.h>
+#include <time.h>
+
+#include "word_count.h"
+
+/* Manifest entry for one input file, identified by the path it was given as. */
+struct snapshot_file {
+    char *path;
+    off_t offset;          /* Bytes included in the snapshot's counts. */
+    off_t size;            /* Size of the file when it was last read. */
+    struct timespec mtime; /* Modification time when it was last read. */
+    char *tail;            /* Bytes of the word at offset, or NULL. */
+};
+
+struct word_snapshot {
+    struct snapshot_file *files;
+    size_t nfiles;
+    size_t cap;
+};
+
+/*
+ * Reads the snapshot at path into snap and adds its counts to a word count
+ * list. A missing snapshot leaves snap empty. Returns 0 on success, -1 if
+ * the snapshot could not be read.
+ */
+int snapshot_load(struct word_snapshot *snap, word_count_list_t *wclist,
+                  const char *path);
+
+/*
+ * Counts whatever was appended to a file since it was recorded in snap, or
+ * the whole file if it is new, and updates its manifest entry. Files that
+ * shrank are skipped with a warning, keeping their old counts. Returns 0 on
+ * success, -1 if the file could not be read.
+ */
+int snapshot_count_file(struct word_snapshot *snap, word_count_list_t *wclist,
+                        const char *filename);
+
+/*
+ * Writes snap and the counts of a word count list to path, replacing any
+ * previous snapshot atomically. Returns 0 on success, -1 on failure.
+ */
+int snapshot_save(struct word_snapshot *snap, word_count_list_t *wclist,
+                  const char *path);
+
+/*
+ * Adds the trailing word of every file in snap to a word count list, giving
+ * the same counts as reading each file whole. Call after snapshot_save.
+ */
+void snapshot_add_tails(struct word_snapshot *snap,
+                        word_count_list_t *wclist);
+
+/* Frees the manifest of snap. */
+void snapshot_free(struct word_snapshot *snap);
+
+#endif /* WORD_SNAPSHOT_H */
@@ -0,0 +1,304 @@
+/*
+ * Implementation of the word_sort interface.
+ */
+
+/*
+ * Copyright (C) 2019 University of California, Berkeley
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "word_sort.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Fewest entries worth sorting on a thread of their own. */
+#define MIN_PER_THREAD 4096
+
+typedef bool less_fn(const word_count_t *, const word_count_t *);
+
+/* Sorts entries[lo, hi), using tmp[lo, hi) as scratch space. */
+static void merge_sort(word_count_t **entries, word_count_t **tmp, size_t lo,
+                       size_t hi, less_fn *less) {
+    if (hi - lo < 2) {
+        return;
+    }
+    size_t mid = lo + (hi - lo) / 2;
+    merge_sort(entries, tmp, lo, mid, less);
+    merge_sort(entries, tmp, mid, hi, less);
+
+    size_t i = lo, j = mid, k = lo;
+    while (i < mid && j < hi) {
+        tmp[k++] = less(entries[j], entries[i]) ? entries[j++] : entries[i++];
+    }
+    while (i < mid) {
+        tmp[k++] = entries[i++];
+    }
+    while (j < hi) {
+        tmp[k++] = entries[j++];
+    }
+    memcpy(&entries[lo], &tmp[lo], (hi - lo) * sizeof(word_count_t *));
+}
+
+/*
+ * Returns how many of the first k entries of the stable merge of a[0, na)
+ * and b[0, nb) come from a.
+ */
+static size_t co_rank(size_t k, word_count_t *const *a, size_t na,
+                      word_count_t *const *b, size_t nb, less_fn *less) {
+    size_t lo = k > nb ? k - nb : 0;
+    size_t hi = k < na ? k : na;
+    while (lo < hi) {
+        size_t i = lo + (hi - lo) / 2;
+        size_t j = k - i;
+        if (j > 0 && i < na && !less(b[j - 1], a[i])) {
+            /* a[i] goes before b[j - 1], so more than i come from a. */
+            lo = i + 1;
+        } else {
+            hi = i;
+        }
+    }
+    return lo;
+}
+
+/*
+ * A unit of work: sorting src[lo, hi) in place, or producing dst[lo + k0,
+ * lo + k1) of the merge of the sorted runs src[lo, mid) and src[mid, hi).
+ */
+struct sort_job {
+    void (*run)(const struct sort_job *job);
+    word_count_t **src;
+    word_count_t **dst;
+    size_t lo, mid, hi;
+    size_t k0, k1;
+    less_fn *less;
+};
+
+static void sort_run(const struct sort_job *job) {
+    merge_sort(job->src, job->dst, job->lo, job->hi, job->less);
+}
+
+static void merge_piece(const struct sort_job *job) {
+    word_count_t *const *a = job->src + job->lo;
+    word_count_t *const *b = job->src + job->mid;
+    size_t na = job->mid - job->lo;
+    size_t nb = job->hi - job->mid;
+    size_t i = co_rank(job->k0, a, na, b, nb, job->less);
+    size_t j = job->k0 - i;
+    size_t i_end = co_rank(job->k1, a, na, b, nb, job->less);
+    size_t j_end = job->k1 - i_end;
+
+    word_count_t **out = job->dst + job->lo + job->k0;
+    while (i < i_end && j < j_end) {
+        *out++ = job->less(b[j], a[i]) ? b[j++] : a[i++];
+    }
+    while (i < i_end) {
+        *out++ = a[i++];
+    }
+    while (j < j_end) {
+        *out++ = b[j++];
+    }
+}
+
+/* Jobs shared by the threads of run_jobs, claimed in order. */
+struct job_pool {
+    struct sort_job *jobs;
+    size_t njobs;
+    size_t next;
+};
+
+static void *pool_worker(void *arg) {
+    struct job_pool *pool = arg;
+    size_t i;
+    while ((i = __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED)) <
+           pool->njobs) {
+        pool->jobs[i].run(&pool->jobs[i]);
+    }
+    return NULL;
+}
+
+/* Runs every job on up to nthreads threads, including the caller. */
+static void run_jobs(struct sort_job *jobs, size_t njobs, int nthreads) {
+    struct job_pool pool = {jobs, njobs, 0};
+    int nworkers = (size_t) nthreads < njobs ? nthreads : (int) njobs;
+    pthread_t *threads = nworkers > 1 ? calloc(nworkers - 1, sizeof(pthread_t))
+                                      : NULL;
+    int started = 0;
+    if (threads != NULL) {
+        /* If a thread cannot be started, the others take its share. */
+        while (started < nworkers - 1 &&
+               pthread_create(&threads[started], NULL, pool_worker, &pool) ==
+                   0) {
+            started++;
+        }
+    }
+    pool_worker(&pool);
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+}
+
+bool sort_entries(word_count_t **entries, size_t n, less_fn *less,
+                  int nthreads) {
+    if (n < 2) {
+        return true;
+    }
+    if (nthreads < 1) {
+        nthreads = 1;
+    }
+    size_t nruns = n / MIN_PER_THREAD;
+    if (nruns > (size_t) nthreads) {
+        nruns = nthreads;
+    } else if (nruns == 0) {
+        nruns = 1;
+    }
+
+    word_count_t **tmp = malloc(n * sizeof(word_count_t *));
+    size_t *bounds = malloc((nruns + 1) * sizeof(size_t));
+    /* A merge round has at most max(pairs, nthreads) + 1 jobs. */
+    struct sort_job *jobs = calloc(nruns + nthreads, sizeof(struct sort_job));
+    if (tmp == NULL || bounds == NULL || jobs == NULL) {
+        perror("malloc");
+        free(tmp);
+        free(bounds);
+        free(jobs);
+        return false;
+    }
+
+    for (size_t r = 0; r <= nruns; r++) {
+        bounds[r] = n / nruns * r + (r == nruns ? n % nruns : 0);
+    }
+    for (size_t r = 0; r < nruns; r++) {
+        jobs[r] = (struct sort_job){sort_run, entries, tmp, bounds[r], 0,
+                                    bounds[r + 1], 0, 0, less};
+    }
+    run_jobs(jobs, nruns, nthreads);
+
+    /* Merge pairs of runs until one is left, alternating buffers. */
+    word_count_t **src = entries, **dst = tmp;
+    while (nruns > 1) {
+        size_t npairs = nruns / 2;
+        size_t pieces = nthreads / npairs > 1 ? nthreads / npairs : 1;
+        size_t njobs = 0;
+        for (size_t p = 0; p < npairs; p++) {
+            size_t lo = bounds[2 * p], mid = bounds[2 * p + 1],
+                   hi = bounds[2 * p + 2];
+            for (size_t q = 0; q < pieces; q++) {
+                jobs[njobs++] = (struct sort_job){
+                    merge_piece, src, dst, lo, mid, hi,
+                    (hi - lo) * q / pieces, (hi - lo) * (q + 1) / pieces,
+                    less};
+            }
+        }
+        if (nruns % 2 != 0) {
+            /* Carry the odd run over by merging it with nothing. */
+            size_t lo = bounds[nruns - 1], hi = bounds[nruns];
+            jobs[njobs++] = (struct sort_job){merge_piece, src, dst, lo, hi,
+                                              hi, 0, hi - lo, less};
+        }
+        run_jobs(jobs, njobs, nthreads);
+
+        for (size_t r = 0; 2 * r < nruns; r++) {
+            bounds[r] = bounds[2 * r];
+        }
+        nruns = (nruns + 1) / 2;
+        bounds[nruns] = n;
+        word_count_t **swap = src;
+        src = dst;
+        dst = swap;
+    }
+    if (src != entries) {
+        memcpy(entries, src, n * sizeof(word_count_t *));
+    }
+
+    free(tmp);
+    free(bounds);
+    free(jobs);
+    return true;
+}
+
+/* An array being filled by wordcount_foreach. */
+struct sort_gather {
+    word_count_t **entries;
+    size_t n;
+};
+
+static void gather_entry(word_count_t *wc, void *aux) {
+    struct sort_gather *gather = aux;
+    gather->entries[gather->n++] = wc;
+}
+
+word_count_t **sort_words(word_count_list_t *wclist, less_fn *less,
+                          int nthreads) {
+    size_t n = len_words(wclist);
+    if (n < 2) {
+        return NULL;
+    }
+    struct sort_gather gather = {malloc(n * sizeof(word_count_t *)), 0};
+    if (gather.entries == NULL) {
+        perror("malloc");
+        return NULL;
+    }
+    wordcount_foreach(wclist, gather_entry, &gather);
+    if (!sort_entries(gather.entries, n, less, nthreads)) {
+        free(gather.entries);
+        return NULL;
+    }
+    return gather.entries;
+}
+
+/* The entry after wc in a chain linked at next_offset. */
+#define CHAIN_NEXT(wc, next_offset)                                            \
+    (*(word_count_t **) ((char *) (wc) + (next_offset)))
+
+/*
+ * Merges two sorted chains into one, taking from a on ties to keep the sort
+ * stable.
+ */
+static word_count_t *merge_chains(word_count_t *a, word_count_t *b,
+                                  size_t next_offset, less_fn *less) {
+    word_count_t *head = NULL;
+    word_count_t **tail = &head;
+    while (a != NULL && b != NULL) {
+        if (less(b, a)) {
+            *tail = b;
+            b = CHAIN_NEXT(b, next_offset);
+        } else {
+            *tail = a;
+            a = CHAIN_NEXT(a, next_offset);
+        }
+        tail = &CHAIN_NEXT(*tail, next_offset);
+    }
+    *tail = a != NULL ? a : b;
+    return head;
+}
+
+word_count_t *sort_chain(word_count_t *head, size_t n, size_t next_offset,
+                         less_fn *less) {
+    if (n < 2) {
+        return head;
+    }
+    word_count_t *mid = head;
+    for (size_t i = 1; i < n / 2; i++) {
+        mid = CHAIN_NEXT(mid, next_offset);
+    }
+    word_count_t *second = CHAIN_NEXT(mid, next_offset);
+    CHAIN_NEXT(mid, next_offset) = NULL;
+    return merge_chains(sort_chain(head, n / 2, next_offset, less),
+                        sort_chain(second, n - n / 2, next_offset, less),
+                        next_offset, less);
+}
@@ -0,0 +1,64 @@
+/*
+ * The word_sort interface sorts arrays of word count entries, optionally on
+ * several threads, and chains of entries linked through a next pointer. The
+ * word_count backends use it to implement wordcount_sort and
+ * wordcount_sort_parallel.
+ */
+
+/*
+ * Copyright (C) 2019 University of California, Berkeley
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef WORD_SORT_H
+#define WORD_SORT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "word_count.h"
+
+/*
+ * Stable merge sort of n entries using up to nthreads threads. The array is
+ * cut into one run per thread and the runs are sorted concurrently. They are
+ * then merged pairwise, with each merge split into independent pieces, so
+ * every round of merging also uses all threads. Returns false, leaving the
+ * array unsorted, if out of memory.
+ */
+bool sort_entries(word_count_t **entries, size_t n,
+                  bool less(const word_count_t *, const word_count_t *),
+                  int nthreads);
+
+/*
+ * Gathers the entries of wclist into an array and sorts it with
+ * sort_entries. Returns the array, of len_words(wclist) entries, for the
+ * caller to relink the list in its order and free. Returns NULL, leaving
+ * wclist alone, if it has fewer than two entries or memory runs out; the
+ * caller then falls back to a sort that needs no memory.
+ */
+word_count_t **sort_words(word_count_list_t *wclist,
+                          bool less(const word_count_t *,
+                                    const word_count_t *),
+                          int nthreads);
+
+/*
+ * Stable merge sort of a NULL-terminated chain of n entries, each linked to
+ * the next by the word_count_t pointer next_offset bytes into it. Needs no
+ * memory. Returns the new first entry.
+ */
+word_count_t *sort_chain(word_count_t *head, size_t n, size_t next_offset,
+                         bool less(const word_count_t *,
+                                   const word_count_t *));
+
+#endif /* WORD_SORT_H */
@@ -0,0 +1,274 @@
+/*
+ * Implementation of the word_spill interface.
+ */
+
+/*
+ * Copyright (C) 2019 University of California, Berkeley
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "word_spill.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "word_io.h"
+
+/*
+ * Most runs read at once. With more runs than this, groups of runs are first
+ * merged into longer ones, which bounds the number of open files and heap
+ * size of the final merge.
+ */
+#define MAX_FANIN 64
+
+void spill_init(struct word_spill *spill, const char *dir) {
+    if (dir == NULL && (dir = getenv("TMPDIR")) == NULL) {
+        dir = "/tmp";
+    }
+    spill->dir = dir;
+    spill->runs = NULL;
+    spill->nruns = 0;
+    spill->cap = 0;
+    pthread_mutex_init(&spill->lock, NULL);
+}
+
+/* Creates an empty, already unlinked, run file in the spill directory. */
+static FILE *new_run(struct word_spill *spill) {
+    size_t len = strlen(spill->dir) + sizeof("/wordcount-XXXXXX");
+    char *path = malloc(len);
+    if (path == NULL) {
+        perror("malloc");
+        return NULL;
+    }
+    snprintf(path, len, "%s/wordcount-XXXXXX", spill->dir);
+    int fd = mkstemp(path);
+    if (fd == -1) {
+        perror(path);
+        free(path);
+        return NULL;
+    }
+    unlink(path);
+    free(path);
+
+    FILE *run = fdopen(fd, "w+");
+    if (run == NULL) {
+        perror("fdopen");
+        close(fd);
+    }
+    return run;
+}
+
+static int add_run(struct word_spill *spill, FILE *run) {
+    pthread_mutex_lock(&spill->lock);
+    if (spill->nruns == spill->cap) {
+        size_t cap = spill->cap ? spill->cap * 2 : 16;
+        FILE **runs = realloc(spill->runs, cap * sizeof(FILE *));
+        if (runs == NULL) {
+            perror("realloc");
+            pthread_mutex_unlock(&spill->lock);
+            return -1;
+        }
+        spill->runs = runs;
+        spill->cap = cap;
+    }
+    spill->runs[spill->nruns++] = run;
+    pthread_mutex_unlock(&spill->lock);
+    return 0;
+}
+
+int spill_words(struct word_spill *spill, word_count_list_t *wclist) {
+    if (len_words(wclist) == 0) {
+        return 0;
+    }
+    FILE *run = new_run(spill);
+    if (run == NULL) {
+        return -1;
+    }
+    if (write_counts_binary(wclist, run, true) != 0 ||
+        add_run(spill, run) != 0) {
+        fclose(run);
+        return -1;
+    }
+    free_words(wclist);
+    return 0;
+}
+
+/* Current record of a run being merged. */
+struct run_cursor {
+    FILE *run;
+    char *word;
+    size_t cap;
+    uint64_t count;
+};
+
+/* Moves to the next record. Returns 1, or 0 at the end of the run, or -1. */
+static int advance(struct run_cursor *cursor) {
+    int status = read_count_record(cursor->run, &cursor->word, &cursor->cap,
+                                   &cursor->count);
+    if (status < 0) {
+        fprintf(stderr, "could not read spilled counts\n");
+    }
+    return status;
+}
+
+/* Restores the min-heap order, by word, below heap[i]. */
+static void heap_sift_down(struct run_cursor **heap, size_t size, size_t i) {
+    for (;;) {
+        size_t min = i;
+        size_t left = 2 * i + 1;
+        size_t right = left + 1;
+        if (left < size && strcmp(heap[left]->word, heap[min]->word) < 0) {
+            min = left;
+        }
+        if (right < size && strcmp(heap[right]->word, heap[min]->word) < 0) {
+            min = right;
+        }
+        if (min == i) {
+            return;
+        }
+        struct run_cursor *tmp = heap[i];
+        heap[i] = heap[min];
+        heap[min] = tmp;
+        i = min;
+    }
+}
+
+/*
+ * Merges nruns sorted runs from their beginning, adding up the counts of a
+ * word found in several runs.
+ */
+static int merge_runs(FILE **runs, size_t nruns,
+                      void emit(const char *word, uint64_t count, void *aux),
+                      void *aux) {
+    struct run_cursor *cursors = calloc(nruns, sizeof(struct run_cursor));
+    struct run_cursor **heap = calloc(nruns, sizeof(struct run_cursor *));
+    char *word = NULL;
+    size_t cap = 0;
+    size_t size = 0;
+    int status = -1;
+    if (cursors == NULL || heap == NULL) {
+        perror("calloc");
+        goto done;
+    }
+
+    for (size_t i = 0; i < nruns; i++) {
+        cursors[i].run = runs[i];
+        if (fflush(runs[i]) == EOF || fseek(runs[i], 0, SEEK_SET) != 0) {
+            perror("could not rewind spilled counts");
+            goto done;
+        }
+        int read = advance(&cursors[i]);
+        if (read < 0) {
+            goto done;
+        } else if (read > 0) {
+            heap[size++] = &cursors[i];
+        }
+    }
+    for (size_t i = size / 2; i-- > 0;) {
+        heap_sift_down(heap, size, i);
+    }
+
+    while (size > 0) {
+        if (cap < heap[0]->cap) {
+            char *grown = realloc(word, heap[0]->cap);
+            if (grown == NULL) {
+                perror("realloc");
+                goto done;
+            }
+            word = grown;
+            cap = heap[0]->cap;
+        }
+        strcpy(word, heap[0]->word);
+
+        uint64_t count = 0;
+        do {
+            count += heap[0]->count;
+            int read = advance(heap[0]);
+            if (read < 0) {
+                goto done;
+            } else if (read == 0) {
+                heap[0] = heap[--size];
+            }
+            heap_sift_down(heap, size, 0);
+        } while (size > 0 && strcmp(heap[0]->word, word) == 0);
+        emit(word, count, aux);
+    }
+    status = 0;
+
+done:
+    if (cursors != NULL) {
+        for (size_t i = 0; i < nruns; i++) {
+            free(cursors[i].word);
+        }
+    }
+    free(cursors);
+    free(heap);
+    free(word);
+    return status;
+}
+
+struct run_writer {
+    FILE *run;
+    bool failed;
+};
+
+static void write_record(const char *word, uint64_t count, void *aux) {
+    struct run_writer *writer = aux;
+    if (write_count_record(writer->run, word, strlen(word), count) != 0) {
+        writer->failed = true;
+    }
+}
+
+int spill_merge(struct word_spill *spill,
+                void emit(const char *word, uint64_t count, void *aux),
+                void *aux) {
+    while (spill->nruns > MAX_FANIN) {
+        FILE *run = new_run(spill);
+        if (run == NULL) {
+            return -1;
+        }
+        struct run_writer writer = {run, false};
+        if (merge_runs(spill->runs, MAX_FANIN, write_record, &writer) != 0 ||
+            writer.failed) {
+            if (writer.failed) {
+                perror("could not write spilled counts");
+            }
+            fclose(run);
+            return -1;
+        }
+
+        /* Replace the merged runs, queueing the new one behind the rest. */
+        for (size_t i = 0; i < MAX_FANIN; i++) {
+            fclose(spill->runs[i]);
+        }
+        spill->nruns -= MAX_FANIN;
+        memmove(spill->runs, spill->runs + MAX_FANIN,
+                spill->nruns * sizeof(FILE *));
+        spill->runs[spill->nruns++] = run;
+    }
+    return merge_runs(spill->runs, spill->nruns, emit, aux);
+}
+
+void spill_destroy(struct word_spill *spill) {
+    for (size_t i = 0; i < spill->nruns; i++) {
+        fclose(spill->runs[i]);
+    }
+    free(spill->runs);
+    spill->runs = NULL;
+    spill->nruns = 0;
+    spill->cap = 0;
+    pthread_mutex_destroy(&spill->lock);
+}
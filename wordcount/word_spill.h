@@ -0,0 +1,69 @@
+/*
+ * The word_spill interface counts vocabularies that do not fit in memory.
+ * Word count lists are flushed to sorted run files whenever they reach a
+ * memory budget, and the runs are merged back into a single stream of counts
+ * in alphabetical order.
+ *
+ * Runs use the word_io record format. They are unlinked as soon as they are
+ * created, so they are removed when closed or when the process exits.
+ */
+
+/*
+ * Copyright (C) 2019 University of California, Berkeley
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef WORD_SPILL_H
+#define WORD_SPILL_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "word_count.h"
+
+struct word_spill {
+    const char *dir; /* Directory holding the run files. */
+    FILE **runs;
+    size_t nruns;
+    size_t cap;
+    pthread_mutex_t lock; /* Protects runs, nruns and cap. */
+};
+
+/*
+ * Initializes an empty spill whose runs are created in dir, or in $TMPDIR or
+ * /tmp if dir is NULL.
+ */
+void spill_init(struct word_spill *spill, const char *dir);
+
+/*
+ * Writes every entry of a word count list to a new run in alphabetical
+ * order, then empties the list with free_words. Safe to call concurrently
+ * on different lists. Returns 0 on success, -1 on failure.
+ */
+int spill_words(struct word_spill *spill, word_count_list_t *wclist);
+
+/*
+ * Merges all runs, calling emit once for each distinct word, in alphabetical
+ * order, with the sum of its counts across runs. Returns 0 on success, -1 on
+ * failure.
+ */
+int spill_merge(struct word_spill *spill,
+                void emit(const char *word, uint64_t count, void *aux),
+                void *aux);
+
+/* Closes and removes every run. */
+void spill_destroy(struct word_spill *spill);
+
+#endif /* WORD_SPILL_H */
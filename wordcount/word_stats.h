@@ -0,0 +1,71 @@
+/*
+ * Optional profiling counters for the word count tools, compiled in with
+ * -DWORDS_STATS (make STATS=1). A thread that wants its work recorded points
+ * thread_stats at its own counters, and the code doing the work adds to them
+ * with the macros below, which compile to nothing without the flag.
+ */
+
+/*
+ * Copyright (C) 2019 University of California, Berkeley
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef WORD_STATS_H
+#define WORD_STATS_H
+
+#ifdef WORDS_STATS
+#include <stdint.h>
+#include <time.h>
+
+struct word_stats {
+    uint64_t bytes;         /* Input bytes scanned. */
+    uint64_t words;         /* Words added to a table. */
+    uint64_t count_ns;      /* Time spent reading and counting input. */
+    uint64_t merge_wait_ns; /* Time spent waiting for merge locks. */
+    uint64_t merge_hold_ns; /* Time spent merging while holding them. */
+    uint64_t merge_entries; /* Entries merged into another table. */
+};
+
+/* Counters of the calling thread, or NULL if it is not recording. */
+extern __thread struct word_stats *thread_stats;
+
+static inline uint64_t stats_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Adds n to a counter of the calling thread. */
+#define STATS_ADD(field, n)                                                    \
+    do {                                                                       \
+        if (thread_stats != NULL) {                                            \
+            thread_stats->field += (n);                                        \
+        }                                                                      \
+    } while (0)
+
+/* Declares t holding the current time. */
+#define STATS_START(t) uint64_t t = stats_now()
+
+/* Adds the time elapsed since STATS_START(t) to a counter. */
+#define STATS_ADD_TIME(field, t) STATS_ADD(field, stats_now() - (t))
+
+#else /* WORDS_STATS */
+
+#define STATS_ADD(field, n) ((void) 0)
+#define STATS_START(t) ((void) 0)
+#define STATS_ADD_TIME(field, t) ((void) 0)
+
+#endif /* WORDS_STATS */
+
+#endif /* WORD_STATS_H */
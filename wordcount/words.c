@@ -23,41 +23,224 @@
 
 #include <assert.h>
 #include <ctype.h>
+#include <getopt.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
+#include "word_approx.h"
 #include "word_count.h"
 #include "word_helpers.h"
+#include "word_prefetch.h"
+#include "word_snapshot.h"
+
+/*
+ * Sketch size and monitored words of --approx: a 2 MiB sketch keeps
+ * estimates within 0.005% of the total count with probability 98%.
+ */
+#define APPROX_WIDTH (64 * 1024)
+#define APPROX_DEPTH 4
+#define APPROX_MIN_WORDS 1024
+
+/* Words printed by --approx without --top. */
+#define APPROX_TOP 20
+
+/* Read input through word_prefetch streams (--prefetch). */
+static bool prefetch = false;
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [--top K] [--utf8] [--ngram N] [--prefetch] "
+            "[--approx] [FILE]...\n"
+            "       %s [--top K] [--utf8] --snapshot SNAPSHOT FILE...\n"
+            "With --snapshot, counts are kept in SNAPSHOT between runs and "
+            "only data\nappended to FILEs since the last run is read.\n"
+            "With --ngram, runs of N consecutive words are counted instead "
+            "of words.\n"
+            "With --prefetch, input is read ahead by a separate thread.\n"
+            "With --approx, only the top K (default %d) words are estimated, "
+            "in fixed memory,\nand printed with a lower bound on their "
+            "counts.\n",
+            prog, prog, APPROX_TOP);
+}
+
+/*
+ * Counts every file in turn, or standard input if there are none, calling
+ * block_done as count_words_blocks does. Returns 0 on success.
+ */
+static int count_inputs(word_count_list_t *wclist, char **filenames,
+                        int nfiles,
+                        bool block_done(word_count_list_t *wclist, void *aux),
+                        void *aux) {
+    for (int i = 0; i < (nfiles > 0 ? nfiles : 1); i++) {
+        const char *filename = nfiles > 0 ? filenames[i] : NULL;
+        FILE *infile = prefetch_open_input(filename, prefetch);
+        if (infile == NULL) {
+            perror(filename != NULL ? filename : "stdin");
+            return 1;
+        }
+        count_words_blocks(wclist, infile, block_done, aux);
+        if (infile != stdin) {
+            fclose(infile);
+        }
+    }
+    return 0;
+}
+
+struct approx_state {
+    struct word_approx approx;
+    int status;
+};
+
+/*
+ * count_words_blocks callback: folds the exact counts of the last block into
+ * the estimator and empties the list, so it never holds more than a block.
+ */
+static bool add_block(word_count_list_t *wclist, void *aux) {
+    struct approx_state *state = aux;
+    state->status = approx_add_words(&state->approx, wclist);
+    free_words(wclist);
+    return state->status == 0;
+}
+
+/*
+ * Estimates the counts of the input in fixed memory and prints the top
+ * words. Returns 0 on success.
+ */
+static int count_approx(word_count_list_t *wclist, char **filenames,
+                        int nfiles, size_t top) {
+    struct approx_state state = {.status = 0};
+    size_t capacity = 16 * top;
+    if (capacity < APPROX_MIN_WORDS) {
+        capacity = APPROX_MIN_WORDS;
+    }
+    if (approx_init(&state.approx, APPROX_WIDTH, APPROX_DEPTH, capacity) !=
+        0) {
+        return 1;
+    }
+    if (count_inputs(wclist, filenames, nfiles, add_block, &state) != 0 ||
+        state.status != 0 || !add_block(wclist, &state)) {
+        approx_destroy(&state.approx);
+        return 1;
+    }
+    approx_print_top(&state.approx, stdout, stderr, top);
+    approx_destroy(&state.approx);
+    return 0;
+}
+
+/*
+ * Adds the counts saved in a snapshot, then reads what is new in each file
+ * and saves the snapshot again. Returns 0 on success.
+ */
+static int count_incremental(word_count_list_t *wclist, const char *path,
+                             char **filenames, int nfiles) {
+    struct word_snapshot snap;
+    if (snapshot_load(&snap, wclist, path) != 0) {
+        return 1;
+    }
+    for (int i = 0; i < nfiles; i++) {
+        if (snapshot_count_file(&snap, wclist, filenames[i]) != 0) {
+            snapshot_free(&snap);
+            return 1;
+        }
+    }
+    if (snapshot_save(&snap, wclist, path) != 0) {
+        snapshot_free(&snap);
+        return 1;
+    }
+    snapshot_add_tails(&snap, wclist);
+    snapshot_free(&snap);
+    return 0;
+}
 
 /*
  * main - handle command line and file handles.
  */
 int main(int argc, char *argv[]) {
+    static const struct option long_options[] = {
+        {"top", required_argument, NULL, 'k'},
+        {"snapshot", required_argument, NULL, 's'},
+        {"utf8", no_argument, NULL, 'u'},
+        {"prefetch", no_argument, NULL, 'p'},
+        {"ngram", required_argument, NULL, 'n'},
+        {"approx", no_argument, NULL, 'a'},
+        {NULL, 0, NULL, 0},
+    };
+    size_t top = 0;
+    const char *snapshot = NULL;
+    bool ngrams = false;
+    bool approx = false;
+    int opt;
+    while ((opt = getopt_long(argc, argv, "k:s:upn:a", long_options, NULL)) !=
+           -1) {
+        switch (opt) {
+        case 'a':
+            approx = true;
+            break;
+        case 's':
+            snapshot = optarg;
+            break;
+        case 'p':
+            prefetch = true;
+            break;
+        case 'n':
+            if (!use_ngrams(atoi(optarg))) {
+                return 1;
+            }
+            ngrams = true;
+            break;
+        case 'u':
+            if (!use_utf8_words()) {
+                return 1;
+            }
+            break;
+        case 'k':
+            if ((top = strtoul(optarg, NULL, 10)) == 0) {
+                usage(argv[0]);
+                return 1;
+            }
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
     /* Create the empty data structure. */
     word_count_list_t word_counts;
-    init_words(&word_counts);
+    init_words_with_arena(&word_counts);
 
-    if (argc <= 1) {
-        count_words(&word_counts, stdin);
-    } else {
-        /* Process each file. */
-        int i;
-        for (i = 1; i < argc; i++) {
-            FILE *infile = fopen(argv[i], "r");
-            if (infile == NULL) {
-                perror("fopen");
-                return 1;
-            }
-            count_words(&word_counts, infile);
-            fclose(infile);
+    if (snapshot != NULL) {
+        /*
+         * A stream has no offsets to resume from, and snapshots map their
+         * files rather than read them. Each run also starts its n-grams
+         * afresh, losing those spanning the previous end of a file.
+         */
+        if (optind >= argc || prefetch || ngrams || approx) {
+            usage(argv[0]);
+            return 1;
         }
+        if (count_incremental(&word_counts, snapshot, argv + optind,
+                              argc - optind) != 0) {
+            return 1;
+        }
+    } else if (approx) {
+        return count_approx(&word_counts, argv + optind, argc - optind,
+                            top > 0 ? top : APPROX_TOP);
+    } else if (count_inputs(&word_counts, argv + optind, argc - optind, NULL,
+                            NULL) != 0) {
+        return 1;
     }
 
     /* Output final result. */
-    wordcount_sort(&word_counts, less_count);
-    fprint_words(&word_counts, stdout);
+    if (top > 0) {
+        fprint_top_words(&word_counts, stdout, top);
+    } else {
+        wordcount_sort(&word_counts, less_count);
+        fprint_words(&word_counts, stdout);
+    }
     return 0;
 }
@@ -0,0 +1,126 @@
+/*
+ * Generates a synthetic text corpus whose word frequencies follow a Zipf
+ * distribution, for benchmarking the word count tools.
+ */
+
+/*
+ * Copyright (C) 2019 University of California, Berkeley
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "word_size.h"
+
+/* Longest word generated for any rank. */
+#define MAX_WORD 16
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [-s BYTES] [-v VOCAB] [-a ALPHA] [-r SEED]\n"
+            "Writes about BYTES of text drawn from VOCAB distinct words, "
+            "where the\nword of rank k has frequency proportional to "
+            "1/k^ALPHA.\n",
+            prog);
+}
+
+/*
+ * Spells rank as a word of at least two lowercase letters, so every rank
+ * maps to a distinct word that the tokenizer keeps whole.
+ */
+static size_t rank_word(char *buf, unsigned long rank) {
+    size_t n = 0;
+    do {
+        buf[n++] = 'a' + rank % 26;
+        rank /= 26;
+    } while (rank > 0 || n < 2);
+    return n;
+}
+
+int main(int argc, char *argv[]) {
+    unsigned long long size = 16 * 1024 * 1024;
+    unsigned long vocab = 50000;
+    double alpha = 1.0;
+    unsigned seed = 162;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "s:v:a:r:")) != -1) {
+        switch (opt) {
+        case 's':
+            size = parse_size(optarg);
+            break;
+        case 'v':
+            vocab = strtoul(optarg, NULL, 10);
+            break;
+        case 'a':
+            alpha = strtod(optarg, NULL);
+            break;
+        case 'r':
+            seed = strtoul(optarg, NULL, 10);
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (vocab == 0 || alpha <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    /* Cumulative distribution over ranks, for sampling by binary search. */
+    double *cdf = malloc(vocab * sizeof(double));
+    if (cdf == NULL) {
+        perror("malloc");
+        return 1;
+    }
+    double total = 0;
+    for (unsigned long k = 0; k < vocab; k++) {
+        total += 1.0 / pow(k + 1, alpha);
+        cdf[k] = total;
+    }
+
+    srand(seed);
+    char word[MAX_WORD + 2];
+    unsigned long long written = 0;
+    unsigned column = 0;
+    while (written < size) {
+        double u = (double) rand() / ((double) RAND_MAX + 1) * total;
+        unsigned long lo = 0, hi = vocab - 1;
+        while (lo < hi) {
+            unsigned long mid = lo + (hi - lo) / 2;
+            if (cdf[mid] <= u) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+
+        size_t n = rank_word(word, lo);
+        column += n + 1;
+        word[n++] = column >= 72 ? '\n' : ' ';
+        if (column >= 72) {
+            column = 0;
+        }
+        fwrite(word, 1, n, stdout);
+        written += n;
+    }
+
+    free(cdf);
+    return 0;
+}